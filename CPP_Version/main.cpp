@@ -8,24 +8,56 @@
 // - CLI operations: entry, exit, search, reports
 // - Smart allocation: nearest spot by floor then spot
 // - Billing by type and duration; reports: occupancy, revenue, peak entry hour
+// - Per-minute occupancy history (lock-free ring buffer) for dashboard queries
+// - Overstay detection via a hierarchical timing wheel (O(expired) per tick)
+// - Pluggable allocation strategies (nearest, distance to anchor, fill evenly, closed floors)
+// - Copy-on-write lot snapshots: reports read a consistent view while gates keep running
+// - Streaming sketches on exit: HyperLogLog unique vehicles, DDSketch durations, 7x24 heatmap
+// - Money in integer cents end to end (billing, transaction log, revenue reports)
+// - Cached local-time table: epoch -> (day, hour) and timestamp formatting without libc
+// - Admission check at entry: Bloom filter in front of a sorted, mmap'd permit/blocklist file
+// - ParkingLot<Floors, Spots, Rates> template: fixed layouts sized at compile time, DYNAMIC at runtime
+// - End-of-day rollup: closed days partitioned into per-day files with summaries (pipelined, --auto-rollup at midnight)
 
 #include <algorithm>
 #include <array>
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
 #include <ctime>
+#include <deque>
 #include <exception>
 #include <fstream>
+#include <functional>
 #include <iomanip>
 #include <iostream>
+#include <iterator>
+#include <map>
 #include <memory>
+#include <mutex>
+#include <random>
+#include <shared_mutex>
 #include <sstream>
 #include <stdexcept>
 #include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 #ifdef _WIN32
 #include <direct.h>
+#include <sys/types.h>
+#include <sys/stat.h>
 #else
+#include <fcntl.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
+#include <unistd.h>
 #endif
 using namespace std;
 
@@ -34,8 +66,14 @@ static const int SPOTS_PER_FLOOR = 20;
 static const char* DATA_DIR_CPP = "data-cpp";
 static const char* PARKING_STATE_CPP = "data-cpp/parking_state.csv";
 static const char* TRANSACTIONS_CPP = "data-cpp/transactions.csv";
+static const char* GEOMETRY_CPP = "data-cpp/geometry.csv";
+static const char* ALLOCATION_CPP = "data-cpp/allocation.csv";
+static const char* SKETCHES_CPP = "data-cpp/sketches.dat";
+static const char* PLATES_CPP = "data-cpp/plates.txt";
+static const char* DAYS_DIR_CPP = "data-cpp/days";
 
 enum class VehicleType { Bike=0, Car=1, Truck=2 };
+static const int VEHICLE_TYPES = 3;
 
 inline string to_string(VehicleType t) {
     switch (t) {
@@ -46,11 +84,184 @@ inline string to_string(VehicleType t) {
     }
 }
 
+// ---------------- Local time ----------------
+// localtime() goes through the timezone machinery, takes a global lock in
+// glibc and is not thread-safe. LocalClock asks libc once at startup for the
+// UTC offset over [now-15y, now+3y), keeps only the instants where the offset
+// changes (DST transitions, found by weekly probing plus bisection), and after
+// that maps an epoch to local (day, hour, ...) with a binary search and integer
+// arithmetic. Times outside the table fall back to localtime_r/localtime_s.
+
+// Days since 1970-01-01 for a civil date (proleptic Gregorian).
+static long long days_from_civil(long long y, unsigned m, unsigned d) {
+    y -= m <= 2;
+    long long era = (y >= 0 ? y : y - 399) / 400;
+    unsigned yoe = static_cast<unsigned>(y - era * 400);
+    unsigned doy = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + d - 1;
+    unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + static_cast<long long>(doe) - 719468;
+}
+
+static void civil_from_days(long long z, long long& y, unsigned& m, unsigned& d) {
+    z += 719468;
+    long long era = (z >= 0 ? z : z - 146096) / 146097;
+    unsigned doe = static_cast<unsigned>(z - era * 146097);
+    unsigned yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    unsigned doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    unsigned mp = (5 * doy + 2) / 153;
+    d = doy - (153 * mp + 2) / 5 + 1;
+    m = mp < 10 ? mp + 3 : mp - 9;
+    y = static_cast<long long>(yoe) + era * 400 + (m <= 2);
+}
+
+class LocalClock {
+    struct Segment { long long start, offset; }; // offset (seconds east of UTC) from `start` on
+    vector<Segment> segs;
+    long long lo{0}, hi{0};
+
+    static long long libc_offset(long long t) {
+        time_t tt = static_cast<time_t>(t); tm lt{};
+#ifdef _WIN32
+        localtime_s(&lt, &tt);
+#else
+        localtime_r(&tt, &lt);
+#endif
+        long long local = days_from_civil(lt.tm_year + 1900, lt.tm_mon + 1, lt.tm_mday) * 86400 + lt.tm_hour * 3600 + lt.tm_min * 60 + lt.tm_sec;
+        return local - t;
+    }
+    static long long floor_div(long long a, long long b) { return a / b - ((a % b != 0) && ((a < 0) != (b < 0))); }
+    static void put(string& out, long long v, int width) {
+        char buf[24]; int n = 0;
+        do { buf[n++] = static_cast<char>('0' + v % 10); v /= 10; } while (v > 0 || n < width);
+        while (n > 0) out += buf[--n];
+    }
+public:
+    struct Parts { long long day; int hour, minute, second; };
+
+    LocalClock() {
+        const long long week = 7 * 86400;
+        long long now = static_cast<long long>(time(nullptr));
+        lo = now - 15LL * 365 * 86400; hi = now + 3LL * 365 * 86400;
+        long long prevT = lo, prevOff = libc_offset(lo);
+        segs.push_back({lo, prevOff});
+        while (prevT < hi) {
+            long long t = min(prevT + week, hi), off = libc_offset(t);
+            if (off != prevOff) {
+                long long a = prevT, b = t; // first second with the new offset lies in (a, b]
+                while (b - a > 1) { long long mid = a + (b - a) / 2; if (libc_offset(mid) == prevOff) a = mid; else b = mid; }
+                segs.push_back({b, off}); prevOff = off;
+            }
+            prevT = t;
+        }
+    }
+    long long offset(long long t) const {
+        if (t < lo || t >= hi) return libc_offset(t);
+        auto it = upper_bound(segs.begin(), segs.end(), t, [](long long v, const Segment& sg) { return v < sg.start; });
+        return prev(it)->offset;
+    }
+    Parts parts(time_t t) const {
+        long long local = static_cast<long long>(t) + offset(static_cast<long long>(t));
+        long long day = floor_div(local, 86400), sec = local - day * 86400;
+        return {day, static_cast<int>(sec / 3600), static_cast<int>(sec / 60 % 60), static_cast<int>(sec % 60)};
+    }
+    long long dayIndex(time_t t) const { return parts(t).day; }
+    int hour(time_t t) const { return parts(t).hour; }
+    static int weekday(long long day) { return static_cast<int>(((day % 7) + 11) % 7); } // 0=Sunday; day 0 was a Thursday
+    // First instant of local day `day` (epoch seconds).
+    time_t dayStart(long long day) const {
+        long long midnight = day * 86400;
+        long long t = midnight - offset(midnight);
+        return static_cast<time_t>(midnight - offset(t));
+    }
+    static string formatDate(long long day) {
+        long long y; unsigned m, d; civil_from_days(day, y, m, d);
+        string out; out.reserve(10);
+        put(out, y, 4); out += '-'; put(out, m, 2); out += '-'; put(out, d, 2);
+        return out;
+    }
+    // "YYYY-MM-DD HH:MM:SS"
+    string format(time_t t) const {
+        Parts p = parts(t);
+        string out = formatDate(p.day); out.reserve(19);
+        out += ' '; put(out, p.hour, 2); out += ':'; put(out, p.minute, 2); out += ':'; put(out, p.second, 2);
+        return out;
+    }
+};
+
+static const LocalClock& local_clock() {
+    static const LocalClock clock;
+    return clock;
+}
+
+// Fixed-point currency in integer cents. Billing, the transaction log and the
+// reports all use it, so totals are exact no matter how many rows are summed.
+class Money {
+    long long c{0};
+    explicit constexpr Money(long long cents) : c(cents) {}
+public:
+    constexpr Money() = default;
+    static constexpr Money fromCents(long long cents) { return Money(cents); }
+    static constexpr Money whole(long long units) { return Money(units * 100); }
+    constexpr long long cents() const { return c; }
+    constexpr Money operator+(Money o) const { return Money(c + o.c); }
+    constexpr Money operator-(Money o) const { return Money(c - o.c); }
+    constexpr Money operator*(long long k) const { return Money(c * k); }
+    Money& operator+=(Money o) { c += o.c; return *this; }
+    constexpr bool operator==(Money o) const { return c == o.c; }
+    constexpr bool operator!=(Money o) const { return c != o.c; }
+    constexpr bool operator<(Money o) const { return c < o.c; }
+    string str() const {
+        unsigned long long a = c < 0 ? 0ULL - static_cast<unsigned long long>(c) : static_cast<unsigned long long>(c);
+        string out = (c < 0 ? "-" : "") + std::to_string(a / 100) + '.';
+        out += static_cast<char>('0' + (a % 100) / 10); out += static_cast<char>('0' + a % 10);
+        return out;
+    }
+    // Parses "12", "12.3", "12.34" or "-12.34"; digits past the cents are rejected.
+    static bool parse(string_view txt, Money& out) {
+        size_t i = 0; bool neg = false;
+        if (i < txt.size() && (txt[i] == '-' || txt[i] == '+')) neg = txt[i++] == '-';
+        long long units = 0; int digits = 0;
+        for (; i < txt.size() && txt[i] >= '0' && txt[i] <= '9'; ++i, ++digits) units = units * 10 + (txt[i] - '0');
+        long long frac = 0; int fd = 0;
+        if (i < txt.size() && txt[i] == '.') {
+            for (++i; i < txt.size() && txt[i] >= '0' && txt[i] <= '9'; ++i, ++fd) { if (fd >= 2) return false; frac = frac * 10 + (txt[i] - '0'); }
+        }
+        if (i != txt.size() || (digits == 0 && fd == 0)) return false;
+        if (fd == 1) frac *= 10;
+        out = Money(neg ? -(units * 100 + frac) : units * 100 + frac);
+        return true;
+    }
+    friend ostream& operator<<(ostream& os, Money m) { return os << m.str(); }
+};
+
+// Integer revenue kernels: plain loops over contiguous cents so the compiler
+// can vectorize them (no float parsing or accumulation).
+static long long sum_cents(const long long* cents, size_t n) {
+    long long total = 0;
+    for (size_t i = 0; i < n; ++i) total += cents[i];
+    return total;
+}
+
+// Sum of cents[i] whose time[i] lies in [lo, hi); branch-free for the same reason.
+static long long sum_cents_between(const long long* times, const long long* cents, size_t n, long long lo, long long hi) {
+    long long total = 0;
+    for (size_t i = 0; i < n; ++i) total += (times[i] >= lo && times[i] < hi) ? cents[i] : 0;
+    return total;
+}
+
+// Fee schedule in cents, indexed by VehicleType. ParkingLot takes a rate table
+// as a template parameter; the Vehicle classes read the standard one.
+struct StandardRates {
+    static constexpr array<long long, VEHICLE_TYPES> firstHour{{2000, 4000, 6000}};
+    static constexpr array<long long, VEHICLE_TYPES> addHour{{1000, 2000, 3000}};
+};
+
 class Vehicle {
 protected:
     string license;
     string owner;
     time_t entryTime{};
+    time_t prepaidUntil{0}; // 0 = no prepaid window
     VehicleType type;
     int floor{-1}, spot{-1};
 public:
@@ -67,20 +278,11 @@ public:
     int getSpot() const { return spot; }
     void setPosition(int f, int s) { floor = f; spot = s; }
     void setEntryTime(time_t t) { entryTime = t; }
-    virtual double rateFirstHour() const = 0;
-    virtual double rateAddHour() const = 0;
-    double calcFee(long durationMinutes) const {
-        long hours = (durationMinutes + 59) / 60; if (hours < 1) hours = 1;
-        double fh = rateFirstHour(); double ah = rateAddHour();
-        if (hours == 1) return fh;
-        return fh + (hours - 1) * ah;
-    }
+    time_t getPrepaidUntil() const { return prepaidUntil; }
+    void setPrepaidUntil(time_t t) { prepaidUntil = t; }
     friend ostream& operator<<(ostream& os, const Vehicle& v) {
-        char buf[64];
-        tm tmEntry = *localtime(&v.entryTime);
-        strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", &tmEntry);
         os << v.license << " (" << to_string(v.type) << ") owner=" << v.owner
-           << " at F" << v.floor << "-S" << v.spot << " entry=" << buf;
+           << " at F" << v.floor << "-S" << v.spot << " entry=" << local_clock().format(v.entryTime);
         return os;
     }
 };
@@ -88,20 +290,14 @@ public:
 class Bike : public Vehicle {
 public:
     using Vehicle::Vehicle;
-    double rateFirstHour() const override { return 20.0; }
-    double rateAddHour() const override { return 10.0; }
 };
 class Car : public Vehicle {
 public:
     using Vehicle::Vehicle;
-    double rateFirstHour() const override { return 40.0; }
-    double rateAddHour() const override { return 20.0; }
 };
 class Truck : public Vehicle {
 public:
     using Vehicle::Vehicle;
-    double rateFirstHour() const override { return 60.0; }
-    double rateAddHour() const override { return 30.0; }
 };
 
 struct ParkingSpot {
@@ -109,38 +305,435 @@ struct ParkingSpot {
     unique_ptr<Vehicle> vehicle{};
 };
 
-static array<array<ParkingSpot, SPOTS_PER_FLOOR>, FLOORS> lot;
+// ---------------- ParkingLot ----------------
+// ParkingLot<Floors, Spots, Rates> owns the spots, an occupancy bitmap (one bit
+// per spot, row-major) and per-floor counters. With a fixed geometry every
+// array, loop bound and the fee table is a compile-time constant, so scans are
+// unrolled for small kiosk layouts. ParkingLot<DYNAMIC, DYNAMIC> has the same
+// interface with the geometry passed to the constructor.
+static const int DYNAMIC = 0;
 
-static void ensure_dir() {
+static inline int lowest_bit(uint64_t w) {
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_ctzll(w);
+#else
+    int i = 0; while (!(w & 1)) { w >>= 1; ++i; } return i;
+#endif
+}
+
+template <int Floors, int Spots>
+struct LotStorage {
+    static_assert(Floors > 0 && Spots > 0, "use DYNAMIC for both dimensions");
+    static constexpr int floors() { return Floors; }
+    static constexpr int spotsPerFloor() { return Spots; }
+    array<ParkingSpot, Floors * Spots> cells{};
+    array<uint64_t, (Floors * Spots + 63) / 64> bits{};
+    array<int, Floors> perFloor{};
+};
+
+template <>
+struct LotStorage<DYNAMIC, DYNAMIC> {
+    int nFloors, nSpots;
+    int floors() const { return nFloors; }
+    int spotsPerFloor() const { return nSpots; }
+    vector<ParkingSpot> cells;
+    vector<uint64_t> bits;
+    vector<int> perFloor;
+    // Members initialize in declaration order, so the dimensions are checked
+    // before any vector is sized from them.
+    LotStorage(int fl, int sp) : nFloors(checked_dimension(fl)), nSpots(checked_dimension(sp)),
+        cells(static_cast<size_t>(nFloors) * nSpots), bits((static_cast<size_t>(nFloors) * nSpots + 63) / 64), perFloor(nFloors) {}
+    static int checked_dimension(int n) {
+        if (n <= 0) throw invalid_argument("Invalid lot geometry");
+        return n;
+    }
+};
+
+template <int Floors, int Spots, class Rates = StandardRates>
+class ParkingLot : private LotStorage<Floors, Spots> {
+    using Storage = LotStorage<Floors, Spots>;
+    int total{0};
+    static constexpr int FEE_TABLE_HOURS = 24;
+    static constexpr array<array<long long, FEE_TABLE_HOURS + 1>, VEHICLE_TYPES> feeTable() {
+        array<array<long long, FEE_TABLE_HOURS + 1>, VEHICLE_TYPES> t{};
+        for (int v = 0; v < VEHICLE_TYPES; ++v)
+            for (int h = 1; h <= FEE_TABLE_HOURS; ++h) t[v][h] = Rates::firstHour[v] + Rates::addHour[v] * (h - 1);
+        return t;
+    }
+    static constexpr auto FEES = feeTable();
+    int index(int f, int s) const { return f * this->spotsPerFloor() + s; }
+public:
+    using Storage::Storage;
+    using Storage::floors;
+    using Storage::spotsPerFloor;
+    int capacity() const { return this->floors() * this->spotsPerFloor(); }
+
+    ParkingSpot& at(int f, int s) { return this->cells[index(f, s)]; }
+    const ParkingSpot& at(int f, int s) const { return this->cells[index(f, s)]; }
+    bool occupied(int f, int s) const { int i = index(f, s); return (this->bits[i >> 6] >> (i & 63)) & 1; }
+    int occupiedOnFloor(int f) const { return this->perFloor[f]; }
+    int occupiedTotal() const { return total; }
+
+    void park(int f, int s, unique_ptr<Vehicle> v) {
+        int i = index(f, s);
+        auto& ps = this->cells[i];
+        if (ps.occupied) throw runtime_error("Spot already occupied");
+        v->setPosition(f, s);
+        ps.vehicle = std::move(v); ps.occupied = true;
+        this->bits[i >> 6] |= 1ULL << (i & 63);
+        ++this->perFloor[f]; ++total;
+    }
+    unique_ptr<Vehicle> release(int f, int s) {
+        int i = index(f, s);
+        auto& ps = this->cells[i];
+        if (!ps.occupied) return nullptr;
+        ps.occupied = false;
+        this->bits[i >> 6] &= ~(1ULL << (i & 63));
+        --this->perFloor[f]; --total;
+        return std::move(ps.vehicle);
+    }
+
+    // Lowest free (floor, spot) in row-major order, via the bitmap.
+    pair<int,int> firstFree() const {
+        const int n = capacity(), words = static_cast<int>(this->bits.size());
+        for (int w = 0; w < words; ++w) {
+            uint64_t freeBits = ~this->bits[w];
+            if (w == words - 1 && (n & 63)) freeBits &= (1ULL << (n & 63)) - 1;
+            if (freeBits) { int i = w * 64 + lowest_bit(freeBits); return {i / this->spotsPerFloor(), i % this->spotsPerFloor()}; }
+        }
+        return {-1,-1};
+    }
+    // Visits only occupied spots.
+    template <class Fn> void forEachOccupied(Fn fn) const {
+        const int words = static_cast<int>(this->bits.size());
+        for (int w = 0; w < words; ++w) {
+            for (uint64_t b = this->bits[w]; b; b &= b - 1) {
+                int i = w * 64 + lowest_bit(b);
+                fn(i / this->spotsPerFloor(), i % this->spotsPerFloor(), this->cells[i]);
+            }
+        }
+    }
+    pair<int,int> find(const string& lic) const {
+        pair<int,int> hit{-1,-1};
+        forEachOccupied([&](int f, int s, const ParkingSpot& ps) { if (hit.first < 0 && ps.vehicle && ps.vehicle->getLicense() == lic) hit = {f, s}; });
+        return hit;
+    }
+
+    static Money fee(VehicleType t, long durationMinutes) {
+        long hours = (durationMinutes + 59) / 60; if (hours < 1) hours = 1;
+        int v = static_cast<int>(t);
+        if (hours <= FEE_TABLE_HOURS) return Money::fromCents(FEES[v][hours]);
+        return Money::fromCents(Rates::firstHour[v] + Rates::addHour[v] * (hours - 1));
+    }
+};
+
+static ParkingLot<FLOORS, SPOTS_PER_FLOOR> lot;
+
+// ---------------- Occupancy history ----------------
+// One sample per minute, kept for the last 24h. Entry and exit are the only
+// writers (single writer); dashboard readers never lock and never block a gate.
+// Each slot is guarded by a sequence counter: odd while being written, readers
+// retry if the counter moved under them.
+static const int HISTORY_MINUTES = 24 * 60;
+
+struct OccupancyCounts {
+    int total{0};
+    array<int, FLOORS> floors{};
+    array<int, VEHICLE_TYPES> types{};
+};
+
+struct OccupancySample {
+    long long minute{-1};   // epoch minute; -1 means no data for that minute
+    int total{0};           // level at the end of the minute
+    int peak{0};            // highest level seen during the minute
+    array<int, FLOORS> floors{};
+    array<int, VEHICLE_TYPES> types{};
+    bool valid() const { return minute >= 0; }
+};
+
+class OccupancyHistory {
+    struct Slot {
+        atomic<uint32_t> seq{0};
+        atomic<long long> minute{-1};
+        atomic<int> total{0}, peak{0};
+        array<atomic<int>, FLOORS> floors{};
+        array<atomic<int>, VEHICLE_TYPES> types{};
+    };
+    array<Slot, HISTORY_MINUTES> ring{};
+    atomic<long long> lastMinute{-1};
+
+    void write(long long m, const OccupancyCounts& c, int peak) {
+        Slot& sl = ring[m % HISTORY_MINUTES];
+        uint32_t q = sl.seq.load(memory_order_relaxed);
+        sl.seq.store(q + 1, memory_order_relaxed);
+        atomic_thread_fence(memory_order_release);
+        sl.minute.store(m, memory_order_relaxed);
+        sl.total.store(c.total, memory_order_relaxed);
+        sl.peak.store(peak, memory_order_relaxed);
+        for (int f = 0; f < FLOORS; ++f) sl.floors[f].store(c.floors[f], memory_order_relaxed);
+        for (int t = 0; t < VEHICLE_TYPES; ++t) sl.types[t].store(c.types[t], memory_order_relaxed);
+        sl.seq.store(q + 2, memory_order_release);
+    }
+    OccupancySample read(long long m) const {
+        const Slot& sl = ring[m % HISTORY_MINUTES];
+        OccupancySample out;
+        while (true) {
+            uint32_t q1 = sl.seq.load(memory_order_acquire);
+            if (q1 & 1u) continue;
+            out.minute = sl.minute.load(memory_order_relaxed);
+            out.total = sl.total.load(memory_order_relaxed);
+            out.peak = sl.peak.load(memory_order_relaxed);
+            for (int f = 0; f < FLOORS; ++f) out.floors[f] = sl.floors[f].load(memory_order_relaxed);
+            for (int t = 0; t < VEHICLE_TYPES; ++t) out.types[t] = sl.types[t].load(memory_order_relaxed);
+            atomic_thread_fence(memory_order_acquire);
+            if (sl.seq.load(memory_order_relaxed) == q1) break;
+        }
+        if (out.minute != m) out = OccupancySample{};
+        return out;
+    }
+public:
+    // Called by the gate after every change (and once at startup).
+    void record(time_t now, const OccupancyCounts& c) {
+        long long m = static_cast<long long>(now) / 60;
+        long long last = lastMinute.load(memory_order_relaxed);
+        if (last >= 0 && m < last) m = last; // clock stepped back: fold into the newest minute
+        if (last >= 0 && m == last) {
+            int peak = max(read(m).peak, c.total);
+            write(m, c, peak);
+            return;
+        }
+        int prevLevel = 0;
+        if (last >= 0) {
+            // Carry the previous level forward over the minutes with no events.
+            OccupancySample prev = read(last);
+            OccupancyCounts carried; carried.total = prev.total; carried.floors = prev.floors; carried.types = prev.types;
+            for (long long g = max(last + 1, m - HISTORY_MINUTES + 1); g < m; ++g) write(g, carried, prev.total);
+            prevLevel = prev.total;
+        }
+        write(m, c, max(prevLevel, c.total));
+        lastMinute.store(m, memory_order_release);
+    }
+    // Samples for the `minutes` minutes ending at `now`, oldest first. Minutes
+    // after the last event repeat the last known level.
+    vector<OccupancySample> window(time_t now, int minutes) const {
+        minutes = max(0, min(minutes, HISTORY_MINUTES));
+        vector<OccupancySample> out; out.reserve(minutes);
+        long long end = static_cast<long long>(now) / 60;
+        long long last = lastMinute.load(memory_order_acquire);
+        OccupancySample tail;
+        if (last >= 0 && end > last) tail = read(last);
+        for (long long m = end - minutes + 1; m <= end; ++m) {
+            if (last < 0) { out.push_back(OccupancySample{}); continue; }
+            if (m > last) {
+                OccupancySample s = tail;
+                if (s.valid()) { s.minute = m; s.peak = s.total; }
+                out.push_back(s);
+            } else if (m <= last - HISTORY_MINUTES) {
+                out.push_back(OccupancySample{});
+            } else {
+                out.push_back(read(m));
+            }
+        }
+        return out;
+    }
+    // Minutes within the window during which every spot was taken.
+    int minutesFull(time_t now, int minutes) const {
+        int full = 0;
+        for (const auto& s : window(now, minutes)) if (s.valid() && s.peak >= FLOORS * SPOTS_PER_FLOOR) ++full;
+        return full;
+    }
+};
+
+static OccupancyCounts occ_counts;
+static OccupancyHistory occ_history;
+
+static void occupancy_recount() {
+    occ_counts = OccupancyCounts{};
+    lot.forEachOccupied([](int f, int, const ParkingSpot& ps) {
+        ++occ_counts.total; ++occ_counts.floors[f]; ++occ_counts.types[static_cast<int>(ps.vehicle->getType())];
+    });
+}
+
+static void occupancy_changed(int f, VehicleType t, int delta, time_t now) {
+    occ_counts.total += delta; occ_counts.floors[f] += delta; occ_counts.types[static_cast<int>(t)] += delta;
+    occ_history.record(now, occ_counts);
+}
+
+static void make_dir(const string& path) {
 #ifdef _WIN32
-    _mkdir(DATA_DIR_CPP);
+    _mkdir(path.c_str());
 #else
-    mkdir(DATA_DIR_CPP, 0755);
+    mkdir(path.c_str(), 0755);
 #endif
 }
+static void ensure_dir() { make_dir(DATA_DIR_CPP); }
 
 static bool save_state() {
     ofstream ofs(PARKING_STATE_CPP);
     if (!ofs) return false;
-    ofs << "floor,spot,license,owner,type,entryTime\n";
-    for (int f = 0; f < FLOORS; ++f) {
-        for (int s = 0; s < SPOTS_PER_FLOOR; ++s) {
-            const auto& ps = lot[f][s];
-            if (ps.occupied && ps.vehicle) {
-                ofs << f << ',' << s << ','
-                    << ps.vehicle->getLicense() << ','
-                    << ps.vehicle->getOwner() << ','
-                    << static_cast<int>(ps.vehicle->getType()) << ','
-                    << static_cast<long long>(ps.vehicle->getEntryTime())
-                    << "\n";
+    ofs << "floor,spot,license,owner,type,entryTime,prepaidUntil\n";
+    lot.forEachOccupied([&](int f, int s, const ParkingSpot& ps) { // occupancy bitmap: skips free spots
+        ofs << f << ',' << s << ','
+            << ps.vehicle->getLicense() << ','
+            << ps.vehicle->getOwner() << ','
+            << static_cast<int>(ps.vehicle->getType()) << ','
+            << static_cast<long long>(ps.vehicle->getEntryTime()) << ','
+            << static_cast<long long>(ps.vehicle->getPrepaidUntil())
+            << "\n";
+    });
+    return static_cast<bool>(ofs);
+}
+
+static VehicleType intToType(int x) {
+    switch (x) { case 0: return VehicleType::Bike; case 1: return VehicleType::Car; default: return VehicleType::Truck; }
+}
+
+static mutex gate_mutex; // serializes entry/exit gates and everything they touch
+
+// ---------------- Deadlines (overstay / prepaid window) ----------------
+// Hierarchical timing wheel with minute resolution: 4 levels x 64 slots, level L
+// slot covers 64^L minutes (~32 years in total). Add/cancel are O(1); advancing
+// one minute fires that minute's slot and, when a level wraps, re-files the one
+// higher-level slot whose range just started. A tick therefore costs
+// O(expired + cascaded + minutes elapsed), never O(parked).
+static const long long MAX_STAY_MINUTES = 24 * 60;
+
+struct DeadlineEvent {
+    string license;
+    int floor{-1}, spot{-1};
+    long long deadlineMinute{0};
+    bool prepaid{false};   // end of a prepaid window rather than the maximum stay
+};
+
+class TimingWheel {
+    static const int LEVELS = 4, SLOT_BITS = 6, SLOTS = 1 << SLOT_BITS;
+    static const int DUE = LEVELS * SLOTS; // extra list: already expired when added
+    struct Node { DeadlineEvent ev; int prev{-1}, next{-1}, bucket{-1}; };
+    vector<Node> nodes;
+    vector<int> freeIds;
+    array<int, LEVELS * SLOTS + 1> heads;
+    unordered_map<string, int> byLicense;
+    long long current{-1}; // every deadline <= current has fired
+
+    void link(int id, int b) {
+        Node& n = nodes[id]; n.bucket = b; n.prev = -1; n.next = heads[b];
+        if (heads[b] >= 0) nodes[heads[b]].prev = id;
+        heads[b] = id;
+    }
+    void unlink(int id) {
+        Node& n = nodes[id];
+        if (n.prev >= 0) nodes[n.prev].next = n.next; else heads[n.bucket] = n.next;
+        if (n.next >= 0) nodes[n.next].prev = n.prev;
+        n.bucket = -1;
+    }
+    void place(int id) {
+        long long d = nodes[id].ev.deadlineMinute;
+        if (d <= current) { link(id, DUE); return; }
+        long long delta = d - current;
+        const long long span = 1LL << (SLOT_BITS * LEVELS);
+        if (delta >= span) d = current + span - 1; // beyond range: park in the top level, re-filed on cascade
+        int level = 0;
+        while (level < LEVELS - 1 && (d - current) >= (1LL << (SLOT_BITS * (level + 1)))) ++level;
+        int slot = static_cast<int>((d >> (SLOT_BITS * level)) & (SLOTS - 1));
+        link(id, level * SLOTS + slot);
+    }
+    void release(int id) {
+        byLicense.erase(nodes[id].ev.license);
+        nodes[id].ev = DeadlineEvent{};
+        freeIds.push_back(id);
+    }
+    template <class Fn> void fireBucket(int b, Fn& fire) {
+        while (heads[b] >= 0) {
+            int id = heads[b];
+            unlink(id);
+            DeadlineEvent ev = nodes[id].ev;
+            release(id);
+            fire(ev);
+        }
+    }
+public:
+    TimingWheel() { heads.fill(-1); }
+    void start(long long nowMinute) { if (current < 0) current = nowMinute; }
+    size_t size() const { return byLicense.size(); }
+
+    // Registers (or replaces) the deadline for a parked vehicle.
+    void add(const DeadlineEvent& ev) {
+        cancel(ev.license);
+        int id;
+        if (!freeIds.empty()) { id = freeIds.back(); freeIds.pop_back(); }
+        else { id = static_cast<int>(nodes.size()); nodes.emplace_back(); }
+        nodes[id].ev = ev;
+        byLicense[ev.license] = id;
+        place(id);
+    }
+    bool cancel(const string& license) {
+        auto it = byLicense.find(license);
+        if (it == byLicense.end()) return false;
+        int id = it->second;
+        unlink(id);
+        release(id);
+        return true;
+    }
+    // Fires every deadline up to and including `nowMinute`.
+    template <class Fn> void advance(long long nowMinute, Fn fire) {
+        fireBucket(DUE, fire);
+        if (current < 0) { current = nowMinute; return; }
+        while (current < nowMinute) {
+            if (byLicense.empty()) { current = nowMinute; break; }
+            ++current;
+            for (int level = LEVELS - 1; level >= 1; --level) {
+                if (current & ((1LL << (SLOT_BITS * level)) - 1)) continue;
+                int b = level * SLOTS + static_cast<int>((current >> (SLOT_BITS * level)) & (SLOTS - 1));
+                int id = heads[b];
+                heads[b] = -1;
+                while (id >= 0) { int nx = nodes[id].next; place(id); id = nx; }
             }
+            fireBucket(static_cast<int>(current & (SLOTS - 1)), fire);
+            fireBucket(DUE, fire);
         }
     }
-    return true;
+};
+
+static TimingWheel deadline_wheel;
+static unordered_map<string, DeadlineEvent> overstays; // fired and still parked
+static vector<function<void(const DeadlineEvent&)>> overstay_hooks;
+
+// Hook for alerting (display boards, SMS, ...). Hooks run on the gate thread.
+static void on_overstay(function<void(const DeadlineEvent&)> hook) { overstay_hooks.push_back(std::move(hook)); }
+
+static void deadline_register(const string& lic, int f, int s, time_t deadline, bool prepaid = false) {
+    deadline_wheel.add(DeadlineEvent{lic, f, s, static_cast<long long>(deadline) / 60, prepaid});
+}
+// Charged at entry for the prepaid window and credited against the fee at exit.
+static Money prepaid_amount(const Vehicle& v) {
+    if (v.getPrepaidUntil() <= v.getEntryTime()) return Money();
+    return lot.fee(v.getType(), static_cast<long>((v.getPrepaidUntil() - v.getEntryTime()) / 60));
 }
 
-static VehicleType intToType(int x) {
-    switch (x) { case 0: return VehicleType::Bike; case 1: return VehicleType::Car; default: return VehicleType::Truck; }
+// The earlier of the prepaid window's end and the maximum stay is the deadline.
+static void deadline_register(const Vehicle& v, int f, int s) {
+    time_t maxStay = v.getEntryTime() + MAX_STAY_MINUTES * 60;
+    if (v.getPrepaidUntil() > 0 && v.getPrepaidUntil() < maxStay) deadline_register(v.getLicense(), f, s, v.getPrepaidUntil(), true);
+    else deadline_register(v.getLicense(), f, s, maxStay);
+}
+
+static void deadline_clear(const string& lic) {
+    deadline_wheel.cancel(lic);
+    overstays.erase(lic);
+}
+
+// Gates register and clear deadlines under gate_mutex, so the tick takes it too;
+// hooks run after it is released.
+static void deadline_tick(time_t now) {
+    vector<DeadlineEvent> fired;
+    {
+        lock_guard<mutex> gate(gate_mutex);
+        deadline_wheel.advance(static_cast<long long>(now) / 60, [&fired](const DeadlineEvent& ev) {
+            overstays[ev.license] = ev;
+            fired.push_back(ev);
+        });
+    }
+    for (const auto& ev : fired) for (auto& hook : overstay_hooks) hook(ev);
 }
 
 static bool load_state() {
@@ -166,48 +759,1167 @@ static bool load_state() {
             case VehicleType::Car: v = make_unique<Car>(lic, own, VehicleType::Car); break;
             case VehicleType::Truck: v = make_unique<Truck>(lic, own, VehicleType::Truck); break;
         }
-    // override entry time and position using setters
-    v->setEntryTime((time_t)entry);
-    v->setPosition(f, s);
-        lot[f][s].occupied = true;
-        lot[f][s].vehicle = std::move(v);
+        if (f < 0 || f >= FLOORS || s < 0 || s >= SPOTS_PER_FLOOR || lot.occupied(f, s)) continue;
+        // override entry time; park() sets the position
+        v->setEntryTime((time_t)entry);
+        if (cols.size() >= 7) v->setPrepaidUntil((time_t)stoll(cols[6])); // older files have no prepaid column
+        lot.park(f, s, std::move(v));
     }
     return true;
 }
 
-static bool append_txn(const string& lic, VehicleType t, time_t entry, time_t exitT, long durationMin, double fee) {
+static long long txn_bytes = 0; // size of transactions.csv as written by this process
+
+// `fee` is the total collected for the stay; `prepaid` is the part of it paid at entry.
+static bool append_txn(const string& lic, VehicleType t, time_t entry, time_t exitT, long durationMin, Money fee, Money prepaid = Money()) {
     // Ensure file exists with header
     ifstream chk(TRANSACTIONS_CPP);
     bool exists = chk.good();
     chk.close();
     ofstream ofs(TRANSACTIONS_CPP, ios::app);
     if (!ofs) return false;
-    if (!exists) ofs << "license,type,entryTime,exitTime,durationMin,fee\n";
+    if (!exists) ofs << "license,type,entryTime,exitTime,durationMin,fee,prepaid\n";
     ofs << lic << ',' << static_cast<int>(t) << ','
         << static_cast<long long>(entry) << ','
         << static_cast<long long>(exitT) << ','
-        << durationMin << ',' << fixed << setprecision(2) << fee << "\n";
+        << durationMin << ',' << fee << ',' << prepaid << "\n";
+    ofs.flush();
+    txn_bytes = static_cast<long long>(ofs.tellp());
     return true;
 }
 
-static pair<int,int> find_nearest_spot() {
-    for (int f = 0; f < FLOORS; ++f) {
-        for (int s = 0; s < SPOTS_PER_FLOOR; ++s) if (!lot[f][s].occupied) return {f,s};
+// ---------------- Allocation strategies ----------------
+// A strategy mirrors which spots are free and answers "which spot next" from a
+// min segment tree, so pick is O(1) and occupy/release are O(log N). Floors can
+// be closed (e.g. for cleaning) under any strategy.
+class MinSegTree {
+    static constexpr long long INF = (1LL << 62);
+    int n{1};
+    vector<pair<long long,int>> t; // (cost, index); ties go to the lower index
+public:
+    explicit MinSegTree(int count = 1) {
+        while (n < count) n <<= 1;
+        t.assign(2 * n, {INF, -1});
+    }
+    void set(int i, long long cost) {
+        int p = i + n; t[p] = {cost, i};
+        for (p >>= 1; p >= 1; p >>= 1) t[p] = min(t[2*p], t[2*p+1]);
+    }
+    void clear(int i) { set(i, INF); }
+    // Index of the cheapest entry, or -1 if none is set.
+    int top() const { return t[1].first >= INF ? -1 : t[1].second; }
+};
+
+class AllocationStrategy {
+protected:
+    int floors, spots;
+    vector<char> freeSpot;  // floors*spots
+    vector<char> closed;    // per floor
+    vector<int> used;       // occupied spots per floor
+    bool available(int f, int s) const { return freeSpot[f*spots + s] && !closed[f]; }
+    virtual void refresh(int f, int s) = 0; // availability of (f,s) changed
+public:
+    AllocationStrategy(int fl, int sp) : floors(fl), spots(sp), freeSpot(fl*sp, 1), closed(fl, 0), used(fl, 0) {}
+    virtual ~AllocationStrategy() = default;
+    virtual string name() const = 0;
+    virtual pair<int,int> pick() const = 0;
+    void occupy(int f, int s) { if (freeSpot[f*spots + s]) { freeSpot[f*spots + s] = 0; ++used[f]; refresh(f, s); } }
+    void release(int f, int s) { if (!freeSpot[f*spots + s]) { freeSpot[f*spots + s] = 1; --used[f]; refresh(f, s); } }
+    void setFloorClosed(int f, bool c) {
+        if (closed[f] == (char)c) return;
+        closed[f] = c;
+        for (int s = 0; s < spots; ++s) refresh(f, s);
     }
-    return {-1,-1};
+    bool floorClosed(int f) const { return closed[f] != 0; }
+};
+
+// Cheapest free spot by a per-spot cost (distance to an entrance, elevator, ...).
+class DistanceStrategy : public AllocationStrategy {
+    string label;
+    vector<long long> cost;
+    MinSegTree tree;
+protected:
+    void refresh(int f, int s) override {
+        int i = f*spots + s;
+        if (available(f, s)) tree.set(i, cost[i]); else tree.clear(i);
+    }
+public:
+    DistanceStrategy(string lbl, int fl, int sp, vector<long long> c)
+        : AllocationStrategy(fl, sp), label(std::move(lbl)), cost(std::move(c)), tree(fl*sp) {
+        for (int i = 0; i < fl*sp; ++i) tree.set(i, cost[i]);
+    }
+    string name() const override { return label; }
+    pair<int,int> pick() const override {
+        int i = tree.top();
+        return i < 0 ? make_pair(-1,-1) : make_pair(i / spots, i % spots);
+    }
+};
+
+// Least-occupied open floor first, then the lowest free spot on it.
+class FillEvenlyStrategy : public AllocationStrategy {
+    MinSegTree floorTree;          // key: occupied count of floors with an allocatable spot
+    vector<MinSegTree> spotTrees;  // key: spot index of allocatable spots
+protected:
+    void refresh(int f, int s) override {
+        if (available(f, s)) spotTrees[f].set(s, s); else spotTrees[f].clear(s);
+        if (!closed[f] && used[f] < spots) floorTree.set(f, used[f]); else floorTree.clear(f);
+    }
+public:
+    FillEvenlyStrategy(int fl, int sp) : AllocationStrategy(fl, sp), floorTree(fl), spotTrees(fl, MinSegTree(sp)) {
+        for (int f = 0; f < fl; ++f) for (int s = 0; s < sp; ++s) refresh(f, s);
+    }
+    string name() const override { return "Fill floors evenly"; }
+    pair<int,int> pick() const override {
+        int f = floorTree.top();
+        if (f < 0) return {-1,-1};
+        return {f, spotTrees[f].top()};
+    }
+};
+
+// Per-spot walking costs from named anchors (entrances, elevators). Built-in
+// anchors assume the ramp enters at spot 0 and the elevator core sits mid-floor;
+// data-cpp/geometry.csv (anchor,floor,spot,cost) overrides or adds anchors.
+struct GeometryAnchor {
+    string name;
+    vector<long long> cost; // floor*spots + spot
+};
+
+static vector<GeometryAnchor> default_geometry(int fl, int sp) {
+    GeometryAnchor entrance{"Entrance", vector<long long>(fl*sp)}, elevator{"Elevator", vector<long long>(fl*sp)};
+    for (int f = 0; f < fl; ++f) for (int s = 0; s < sp; ++s) {
+        entrance.cost[f*sp + s] = f * 40LL * sp + s * 10LL; // ramp: each floor is a full lap further
+        elevator.cost[f*sp + s] = f * 5LL + abs(s - sp / 2) * 10LL;
+    }
+    return {entrance, elevator};
 }
 
-static pair<bool,pair<int,int>> find_vehicle(const string& lic) {
-    for (int f = 0; f < FLOORS; ++f) for (int s = 0; s < SPOTS_PER_FLOOR; ++s) {
-        if (lot[f][s].occupied && lot[f][s].vehicle && lot[f][s].vehicle->getLicense() == lic) return {true,{f,s}};
+static vector<GeometryAnchor> load_geometry() {
+    auto anchors = default_geometry(FLOORS, SPOTS_PER_FLOOR);
+    ifstream ifs(GEOMETRY_CPP);
+    if (!ifs) return anchors;
+    string line; getline(ifs, line); // header
+    while (getline(ifs, line)) {
+        if (line.empty()) continue;
+        stringstream ss(line); string col; vector<string> cols; while (getline(ss, col, ',')) cols.push_back(col);
+        if (cols.size() < 4) continue;
+        try {
+            int f = stoi(cols[1]), s = stoi(cols[2]); long long c = stoll(cols[3]);
+            if (f < 0 || f >= FLOORS || s < 0 || s >= SPOTS_PER_FLOOR) continue;
+            auto it = find_if(anchors.begin(), anchors.end(), [&](const GeometryAnchor& a) { return a.name == cols[0]; });
+            if (it == anchors.end()) {
+                // Spots not listed for a new anchor rank after every listed one.
+                GeometryAnchor a{cols[0], vector<long long>(FLOORS*SPOTS_PER_FLOOR)};
+                for (int i = 0; i < FLOORS*SPOTS_PER_FLOOR; ++i) a.cost[i] = (1LL << 40) + i;
+                anchors.push_back(std::move(a)); it = anchors.end() - 1;
+            }
+            it->cost[f*SPOTS_PER_FLOOR + s] = c;
+        } catch (...) { cerr << "Warning: bad geometry row: " << line << "\n"; }
+    }
+    return anchors;
+}
+
+static vector<GeometryAnchor> geometry;
+static unique_ptr<AllocationStrategy> spot_allocator;
+
+// Policy menu order: 0 = nearest (row-major), 1..A = nearest to anchor, A+1 = fill evenly.
+static int strategy_count() { return static_cast<int>(geometry.size()) + 2; }
+
+static string strategy_name(int idx) {
+    if (idx == 0) return "Nearest (floor, spot order)";
+    if (idx <= static_cast<int>(geometry.size())) return "Nearest to " + geometry[idx - 1].name;
+    if (idx == strategy_count() - 1) return "Fill floors evenly";
+    throw invalid_argument("Invalid allocation policy");
+}
+
+static unique_ptr<AllocationStrategy> make_strategy(int idx) {
+    if (idx == 0) {
+        vector<long long> rowMajor(FLOORS*SPOTS_PER_FLOOR);
+        for (int i = 0; i < FLOORS*SPOTS_PER_FLOOR; ++i) rowMajor[i] = i;
+        return make_unique<DistanceStrategy>(strategy_name(idx), FLOORS, SPOTS_PER_FLOOR, rowMajor);
     }
-    return {false,{-1,-1}};
+    if (idx <= static_cast<int>(geometry.size())) return make_unique<DistanceStrategy>(strategy_name(idx), FLOORS, SPOTS_PER_FLOOR, geometry[idx - 1].cost);
+    if (idx == strategy_count() - 1) return make_unique<FillEvenlyStrategy>(FLOORS, SPOTS_PER_FLOOR);
+    throw invalid_argument("Invalid allocation policy");
+}
+
+// Swaps in a new policy, carrying over closed floors and current occupancy.
+static void use_strategy(unique_ptr<AllocationStrategy> next) {
+    for (int f = 0; f < FLOORS; ++f) {
+        if (spot_allocator) next->setFloorClosed(f, spot_allocator->floorClosed(f));
+        for (int s = 0; s < SPOTS_PER_FLOOR; ++s) if (lot.occupied(f, s)) next->occupy(f, s);
+    }
+    spot_allocator = std::move(next);
+}
+
+static pair<int,int> find_nearest_spot() {
+    return spot_allocator->pick();
 }
 
 static void trim(string& s) {
     while (!s.empty() && (s.back()=='\r' || s.back()=='\n')) s.pop_back();
 }
 
+// data-cpp/allocation.csv: header, then "closedFloors,policy" with closed floors
+// 1-based and space-separated (the policy name may contain commas). The policy
+// is stored by name so it survives anchors being added to geometry.csv.
+static bool save_allocation() {
+    ofstream ofs(ALLOCATION_CPP);
+    ofs << "closedFloors,policy\n";
+    bool first = true;
+    for (int f = 0; f < FLOORS; ++f) if (spot_allocator->floorClosed(f)) { ofs << (first ? "" : " ") << (f+1); first = false; }
+    ofs << ',' << spot_allocator->name() << "\n";
+    return static_cast<bool>(ofs);
+}
+
+static void load_allocation() {
+    ifstream ifs(ALLOCATION_CPP);
+    if (!ifs) return;
+    string line; getline(ifs, line); // header
+    if (!getline(ifs, line)) return;
+    trim(line);
+    size_t comma = line.find(',');
+    if (comma == string::npos) { cerr << "Warning: bad allocation settings: " << line << "\n"; return; }
+    string policy = line.substr(comma + 1);
+    int n = strategy_count(), idx = 0;
+    while (idx < n && strategy_name(idx) != policy) ++idx;
+    if (idx < n) use_strategy(make_strategy(idx));
+    else cerr << "Warning: allocation policy \"" << policy << "\" no longer exists, using " << spot_allocator->name() << "\n";
+    stringstream ss(line.substr(0, comma)); long long f;
+    while (ss >> f) if (f >= 1 && f <= FLOORS) spot_allocator->setFloorClosed(static_cast<int>(f) - 1, true);
+}
+
+// ---------------- Snapshots ----------------
+// Gates publish an immutable LotSnapshot after every change; reports grab the
+// current one and read it for as long as they like. Copy-on-write per floor:
+// a change copies one FloorSnapshot plus the small top-level array, unchanged
+// floors are shared. Old snapshots are freed when the last reader drops them.
+// Gates serialize among themselves on gate_mutex; reports never take it.
+struct SpotView {
+    bool occupied{false};
+    string license, owner;
+    VehicleType type{VehicleType::Car};
+    time_t entryTime{0};
+};
+
+struct FloorSnapshot {
+    array<SpotView, SPOTS_PER_FLOOR> spots{};
+    int occupied{0};
+};
+
+// Closed-day summaries written by the end-of-day rollup (see below).
+struct DaySummary {
+    long long sessions{0};
+    array<long long, VEHICLE_TYPES> revenueCents{};
+    array<long long, 24> entriesByHour{};
+    void merge(const DaySummary& o) {
+        sessions += o.sessions;
+        for (int t = 0; t < VEHICLE_TYPES; ++t) revenueCents[t] += o.revenueCents[t];
+        for (int h = 0; h < 24; ++h) entriesByHour[h] += o.entriesByHour[h];
+    }
+};
+
+struct RollupIndex {
+    map<long long, DaySummary> days; // local day index -> summary
+    DaySummary total() const { DaySummary s; for (const auto& kv : days) s.merge(kv.second); return s; }
+};
+
+static shared_ptr<const RollupIndex> rollup_index_ptr = make_shared<RollupIndex>();
+static shared_ptr<const RollupIndex> rollup_index() { return atomic_load(&rollup_index_ptr); }
+
+struct LotSnapshot {
+    array<shared_ptr<const FloorSnapshot>, FLOORS> floors{};
+    OccupancyCounts counts;
+    long long txnBytes{0};   // transactions.csv prefix that belongs to this view
+    shared_ptr<const RollupIndex> days; // closed days already moved out of that log
+    unsigned long long version{0};
+};
+
+// Shared by reports while they read transactions.csv, exclusive while the
+// rollup swaps it, so a report's log always matches its snapshot's `days`.
+// Lock order: txn_log_mutex, then gate_mutex. Gates never take it.
+static shared_mutex txn_log_mutex;
+static shared_ptr<const LotSnapshot> current_snapshot_ptr;
+
+static shared_ptr<const LotSnapshot> current_snapshot() { return atomic_load(&current_snapshot_ptr); }
+
+static shared_ptr<const FloorSnapshot> capture_floor(int f) {
+    auto fs = make_shared<FloorSnapshot>();
+    for (int s = 0; s < SPOTS_PER_FLOOR; ++s) {
+        const auto& ps = lot.at(f, s);
+        if (!ps.occupied || !ps.vehicle) continue;
+        fs->spots[s] = SpotView{true, ps.vehicle->getLicense(), ps.vehicle->getOwner(), ps.vehicle->getType(), ps.vehicle->getEntryTime()};
+        ++fs->occupied;
+    }
+    return fs;
+}
+
+// Full rebuild (startup); gates use publish_floor.
+static void publish_all() {
+    auto snap = make_shared<LotSnapshot>();
+    for (int f = 0; f < FLOORS; ++f) snap->floors[f] = capture_floor(f);
+    snap->counts = occ_counts; snap->txnBytes = txn_bytes; snap->days = rollup_index();
+    auto prev = current_snapshot();
+    snap->version = prev ? prev->version + 1 : 1;
+    atomic_store(&current_snapshot_ptr, shared_ptr<const LotSnapshot>(std::move(snap)));
+}
+
+// Republishes after spot (f,s) changed. Caller holds gate_mutex.
+static void publish_spot(int f, int s) {
+    auto prev = current_snapshot();
+    if (!prev) { publish_all(); return; }
+    auto fs = make_shared<FloorSnapshot>(*prev->floors[f]);
+    const auto& ps = lot.at(f, s);
+    bool was = fs->spots[s].occupied;
+    if (ps.occupied && ps.vehicle) fs->spots[s] = SpotView{true, ps.vehicle->getLicense(), ps.vehicle->getOwner(), ps.vehicle->getType(), ps.vehicle->getEntryTime()};
+    else fs->spots[s] = SpotView{};
+    fs->occupied += (int)fs->spots[s].occupied - (int)was;
+    auto snap = make_shared<LotSnapshot>(*prev);
+    snap->floors[f] = std::move(fs);
+    snap->counts = occ_counts; snap->txnBytes = txn_bytes; snap->version = prev->version + 1;
+    atomic_store(&current_snapshot_ptr, shared_ptr<const LotSnapshot>(std::move(snap)));
+}
+
+// In-memory side of a gate operation; callers hold gate_mutex and handle files.
+static void gate_park(int f, int s, unique_ptr<Vehicle> v) {
+    VehicleType vt = v->getType();
+    time_t entry = v->getEntryTime();
+    deadline_register(*v, f, s);
+    lot.park(f, s, std::move(v));
+    spot_allocator->occupy(f, s);
+    occupancy_changed(f, vt, +1, entry);
+    publish_spot(f, s);
+}
+
+static unique_ptr<Vehicle> gate_release(int f, int s, time_t now) {
+    auto v = lot.release(f, s);
+    spot_allocator->release(f, s);
+    occupancy_changed(f, v->getType(), -1, now);
+    deadline_clear(v->getLicense());
+    publish_spot(f, s);
+    return v;
+}
+
+// Calls fn for each row in the first `limit` bytes of a transaction CSV.
+static void scan_csv(const string& path, long long limit, const function<void(const vector<string>&)>& fn) {
+    ifstream ifs(path, ios::binary);
+    if (!ifs) return;
+    string line;
+    if (!getline(ifs, line)) return; // header
+    long long pos = static_cast<long long>(line.size()) + 1;
+    while (pos < limit && getline(ifs, line)) {
+        pos += static_cast<long long>(line.size()) + 1;
+        trim(line);
+        if (line.empty()) continue;
+        stringstream ss(line); string col; vector<string> cols; while (getline(ss,col,',')) cols.push_back(col);
+        fn(cols);
+    }
+}
+static void scan_txns(long long limit, const function<void(const vector<string>&)>& fn) { scan_csv(TRANSACTIONS_CPP, limit, fn); }
+
+// ---------------- End-of-day rollup ----------------
+// Closed days move out of transactions.csv into days/YYYY-MM-DD.csv plus one
+// precomputed row per day in days/summaries.csv, so the live log only holds
+// the open day and reports read old days from their summaries (DaySummary and
+// RollupIndex sit next to LotSnapshot, which carries the current index).
+static string partition_path(const string& dir, long long day) { return dir + "/" + LocalClock::formatDate(day) + ".csv"; }
+
+// Moves tmp over target; rename() already replaces atomically on POSIX.
+static bool replace_file(const string& tmp, const string& target) {
+#ifdef _WIN32
+    remove(target.c_str());
+#endif
+    return rename(tmp.c_str(), target.c_str()) == 0;
+}
+
+static bool parse_ll(string_view s, long long& out) {
+    size_t i = 0; bool neg = !s.empty() && s[0] == '-';
+    if (neg) ++i;
+    if (i == s.size()) return false;
+    long long v = 0;
+    for (; i < s.size(); ++i) { if (s[i] < '0' || s[i] > '9') return false; v = v * 10 + (s[i] - '0'); }
+    out = neg ? -v : v;
+    return true;
+}
+
+static void split_fields(string_view line, vector<string_view>& cols) {
+    cols.clear();
+    size_t start = 0;
+    for (size_t i = 0; i <= line.size(); ++i) if (i == line.size() || line[i] == ',') { cols.push_back(line.substr(start, i - start)); start = i + 1; }
+}
+
+// date,sessions,revenueBike,revenueCar,revenueTruck,h00..h23 (entries per hour)
+// Unreadable rows are skipped and counted in `skipped`; this can run on the
+// rollup thread, so it does not print.
+static bool load_summaries(const string& dir, RollupIndex& idx, long long& skipped) {
+    ifstream ifs(dir + "/summaries.csv", ios::binary);
+    if (!ifs) return false;
+    string line; getline(ifs, line); // header
+    vector<string_view> cols;
+    while (getline(ifs, line)) {
+        trim(line); if (line.empty()) continue;
+        split_fields(line, cols);
+        long long y = 0, m = 0, d = 0; DaySummary s;
+        bool ok = cols.size() == 5 + 24 && cols[0].size() == 10 && parse_ll(cols[0].substr(0, 4), y) && parse_ll(cols[0].substr(5, 2), m)
+               && parse_ll(cols[0].substr(8, 2), d) && parse_ll(cols[1], s.sessions);
+        for (int t = 0; ok && t < VEHICLE_TYPES; ++t) { Money rev; ok = Money::parse(cols[2 + t], rev); s.revenueCents[t] = rev.cents(); }
+        for (int h = 0; ok && h < 24; ++h) ok = parse_ll(cols[5 + h], s.entriesByHour[h]);
+        if (!ok) { ++skipped; continue; }
+        idx.days[days_from_civil(y, static_cast<unsigned>(m), static_cast<unsigned>(d))].merge(s);
+    }
+    return true;
+}
+
+static bool write_summaries(const string& path, const RollupIndex& idx) {
+    ofstream ofs(path, ios::binary | ios::trunc);
+    if (!ofs) return false;
+    ofs << "date,sessions,revenueBike,revenueCar,revenueTruck";
+    for (int h = 0; h < 24; ++h) ofs << ",h" << (h < 10 ? "0" : "") << h;
+    ofs << "\n";
+    for (const auto& kv : idx.days) {
+        const DaySummary& s = kv.second;
+        ofs << LocalClock::formatDate(kv.first) << ',' << s.sessions;
+        for (auto c : s.revenueCents) ofs << ',' << Money::fromCents(c);
+        for (auto c : s.entriesByHour) ofs << ',' << c;
+        ofs << "\n";
+    }
+    return static_cast<bool>(ofs.flush());
+}
+
+// Finishes a committed rollup: each line names a temp file that replaces the
+// file without its ".tmp" suffix, in order, stopping at the first failure so a
+// later line never lands before an earlier one. A line "tmp <end> <size>" is
+// the log: rows appended to the target past byte <end> since the commit are
+// carried over after the first <size> bytes of tmp first. Safe to repeat after
+// a crash part-way through.
+static bool apply_rollup_journal(const string& journal) {
+    ifstream j(journal, ios::binary);
+    if (!j) return true;
+    string line; bool ok = true;
+    while (ok && getline(j, line)) {
+        trim(line);
+        string tmp = line; long long end = -1, size = -1;
+        size_t b = line.rfind(' '), a = b == string::npos || b == 0 ? string::npos : line.rfind(' ', b - 1);
+        if (a != string::npos && parse_ll(string_view(line).substr(a + 1, b - a - 1), end) && parse_ll(string_view(line).substr(b + 1), size)) tmp = line.substr(0, a);
+        if (tmp.size() <= 4) continue;
+        if (!ifstream(tmp, ios::binary)) continue; // already moved
+        string target = tmp.substr(0, tmp.size() - 4);
+        if (size >= 0) {
+            ifstream head(tmp, ios::binary), tail(target, ios::binary);
+            ofstream out(tmp + ".carry", ios::binary | ios::trunc);
+            string buf(static_cast<size_t>(size), '\0');
+            if (!head.read(&buf[0], size)) { ok = false; break; }
+            out.write(buf.data(), size);
+            if (tail && tail.seekg(end) && tail.peek() != EOF) out << tail.rdbuf();
+            out.close();
+            if (!out || !replace_file(tmp + ".carry", tmp)) { ok = false; break; }
+        }
+        ok = replace_file(tmp, target);
+    }
+    j.close();
+    if (ok) remove(journal.c_str());
+    return ok;
+}
+
+// Blocking FIFO with a fixed capacity: a slow stage stalls the ones before it
+// instead of letting them buffer the whole file.
+template <class T>
+class BoundedQueue {
+    mutex m;
+    condition_variable notFull, notEmpty;
+    deque<T> items;
+    size_t cap;
+    bool closed{false};
+public:
+    explicit BoundedQueue(size_t capacity) : cap(capacity) {}
+    void push(T v) {
+        unique_lock<mutex> lk(m);
+        notFull.wait(lk, [&] { return items.size() < cap; });
+        items.push_back(std::move(v));
+        notEmpty.notify_one();
+    }
+    // False once the producer has closed the queue and it is drained.
+    bool pop(T& out) {
+        unique_lock<mutex> lk(m);
+        notEmpty.wait(lk, [&] { return !items.empty() || closed; });
+        if (items.empty()) return false;
+        out = std::move(items.front()); items.pop_front();
+        notFull.notify_one();
+        return true;
+    }
+    void close() { lock_guard<mutex> lk(m); closed = true; notEmpty.notify_all(); }
+};
+
+struct RollupRow { bool ok; long long day; int hour, type; long long cents; string_view line; };
+struct RollupBatch { shared_ptr<const string> text; vector<RollupRow> rows; }; // rows point into text
+struct RollupBlock { long long day; string text; };
+struct RollupStats { long long rows{0}, rolled{0}, kept{0}, malformed{0}, bytes{0}, badSummaries{0}; int days{0}; };
+
+// license,type,entryTime,exitTime,durationMin,fee; a session belongs to the day it exited.
+static bool parse_rollup_row(string_view line, const LocalClock& clock, RollupRow& r, vector<string_view>& cols) {
+    split_fields(line, cols);
+    long long type = 0, entry = 0, exitT = 0, dur = 0; Money fee;
+    if (cols.size() < 6 || cols[0].empty() || !parse_ll(cols[1], type) || type < 0 || type >= VEHICLE_TYPES || !parse_ll(cols[2], entry)
+        || !parse_ll(cols[3], exitT) || !parse_ll(cols[4], dur) || !Money::parse(cols[5], fee)) return false;
+    r.day = clock.dayIndex(static_cast<time_t>(exitT)); r.hour = clock.hour(static_cast<time_t>(entry));
+    r.type = static_cast<int>(type); r.cents = fee.cents();
+    return true;
+}
+
+// After a log swap: the new log length and summary index, published together.
+// Callers hold txn_log_mutex and gate_mutex.
+static void republish_rollup(const string& txnPath, shared_ptr<RollupIndex> idx) {
+    ifstream txf(txnPath, ios::binary | ios::ate);
+    txn_bytes = txf ? static_cast<long long>(txf.tellg()) : 0;
+    atomic_store(&rollup_index_ptr, shared_ptr<const RollupIndex>(std::move(idx)));
+    publish_all();
+}
+
+// Rolls every day before `today` out of txnPath into dir. Four stages on their
+// own threads, joined by bounded queues: read (4 MB chunks cut at line ends) ->
+// parse -> aggregate (per-day summaries and output buffers) -> write (per-day
+// partition temp files). Only the prefix present at the start is processed;
+// rows appended meanwhile are carried over. Nothing visible changes until the
+// commit: a journal of temp -> final renames is written, then applied, and
+// apply_rollup_journal() finishes it on the next start if we die in between.
+// With `live` the log swap happens under txn_log_mutex and gate_mutex, and the
+// summary index is republished inside the lot snapshot.
+static bool run_rollup(const string& txnPath, const string& dir, long long today, bool live, RollupStats& st, string& err) {
+    st = RollupStats{};
+    make_dir(dir);
+    const string journal = dir + "/rollup.journal", summaries = dir + "/summaries.csv", txnTmp = txnPath + ".tmp";
+    if (ifstream(journal, ios::binary)) {
+        // An apply that failed earlier in this process: finishing it swaps the log, so do it like a commit.
+        unique_lock<shared_mutex> logLock(txn_log_mutex, defer_lock);
+        unique_lock<mutex> gate(gate_mutex, defer_lock);
+        if (live) { logLock.lock(); gate.lock(); }
+        if (!apply_rollup_journal(journal)) { err = "could not finish the previous rollup (" + journal + ")"; return false; }
+        if (live) {
+            auto idx = make_shared<RollupIndex>();
+            load_summaries(dir, *idx, st.badSummaries);
+            republish_rollup(txnPath, std::move(idx));
+        }
+    }
+    long long limit = 0;
+    {
+        unique_lock<mutex> gate(gate_mutex, defer_lock); if (live) gate.lock();
+        ifstream probe(txnPath, ios::binary | ios::ate);
+        if (!probe) return true; // nothing logged yet
+        limit = static_cast<long long>(probe.tellg());
+    }
+    ifstream in(txnPath, ios::binary);
+    string header;
+    if (!in || !getline(in, header)) return true;
+    const long long start = static_cast<long long>(header.size()) + 1;
+    trim(header);
+
+    const size_t CHUNK = 4 << 20, FLUSH = 1 << 20, BUFFERED_MAX = 16 << 20;
+    const LocalClock& clock = local_clock();
+    BoundedQueue<shared_ptr<const string>> chunks(4);
+    BoundedQueue<RollupBatch> batches(4);
+    BoundedQueue<RollupBlock> blocks(8);
+
+    thread reader([&] {
+        string carry; long long pos = start;
+        while (pos < limit) {
+            auto chunk = make_shared<string>(std::move(carry)); carry.clear();
+            size_t old = chunk->size(), want = static_cast<size_t>(min<long long>(CHUNK, limit - pos));
+            chunk->resize(old + want);
+            in.read(&(*chunk)[old], static_cast<streamsize>(want));
+            size_t got = static_cast<size_t>(in.gcount());
+            chunk->resize(old + got);
+            if (got == 0) { carry = std::move(*chunk); break; } // file shrank underneath us
+            pos += static_cast<long long>(got);
+            if (pos < limit) {
+                size_t cut = chunk->rfind('\n');
+                if (cut == string::npos) { carry = std::move(*chunk); continue; }
+                carry.assign(*chunk, cut + 1, string::npos); chunk->resize(cut + 1);
+            }
+            st.bytes += static_cast<long long>(chunk->size());
+            chunks.push(std::move(chunk));
+        }
+        if (!carry.empty()) { st.bytes += static_cast<long long>(carry.size()); chunks.push(make_shared<string>(std::move(carry))); }
+        chunks.close();
+    });
+    thread parser([&] {
+        shared_ptr<const string> chunk; vector<string_view> cols;
+        while (chunks.pop(chunk)) {
+            RollupBatch b; b.text = chunk;
+            string_view all(*chunk);
+            b.rows.reserve(all.size() / 40);
+            for (size_t p = 0; p < all.size();) {
+                size_t e = all.find('\n', p); if (e == string_view::npos) e = all.size();
+                string_view line = all.substr(p, e - p); p = e + 1;
+                if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+                if (line.empty()) continue;
+                RollupRow r{}; r.line = line; r.ok = parse_rollup_row(line, clock, r, cols);
+                b.rows.push_back(r);
+            }
+            batches.push(std::move(b));
+        }
+        batches.close();
+    });
+    map<long long, string> tmpFiles; // day -> partition temp file; owned by the writer until joined
+    bool writeFailed = false;
+    thread writer([&] {
+        RollupBlock blk;
+        while (blocks.pop(blk)) {
+            if (writeFailed) continue; // keep draining so the aggregator never blocks
+            string final = partition_path(dir, blk.day), tmp = final + ".tmp";
+            bool first = tmpFiles.emplace(blk.day, tmp).second;
+            ofstream ofs(tmp, first ? ios::binary | ios::trunc : ios::binary | ios::app);
+            if (first) { // a day partitioned by an earlier run is extended, not replaced
+                ifstream old(final, ios::binary);
+                if (old && old.peek() != EOF) ofs << old.rdbuf(); else ofs << header << "\n";
+            }
+            ofs.write(blk.text.data(), static_cast<streamsize>(blk.text.size()));
+            if (!ofs.flush()) writeFailed = true;
+        }
+    });
+
+    map<long long, DaySummary> fresh; map<long long, string> pending; size_t buffered = 0; string kept;
+    auto flush = [&](map<long long, string>::iterator it) {
+        buffered -= it->second.size();
+        blocks.push(RollupBlock{it->first, std::move(it->second)});
+        return pending.erase(it);
+    };
+    RollupBatch b;
+    while (batches.pop(b)) {
+        for (const auto& r : b.rows) {
+            ++st.rows;
+            if (!r.ok || r.day >= today) { // open day, and rows we cannot read, stay in the log
+                kept.append(r.line.data(), r.line.size()); kept += '\n';
+                if (r.ok) ++st.kept; else ++st.malformed;
+                continue;
+            }
+            DaySummary& s = fresh[r.day];
+            ++s.sessions; s.revenueCents[r.type] += r.cents; ++s.entriesByHour[r.hour];
+            auto it = pending.emplace(r.day, string()).first;
+            it->second.append(r.line.data(), r.line.size()); it->second += '\n';
+            buffered += r.line.size() + 1; ++st.rolled;
+            if (it->second.size() >= FLUSH) flush(it);
+        }
+        if (buffered >= BUFFERED_MAX) for (auto it = pending.begin(); it != pending.end();) it = flush(it);
+    }
+    for (auto it = pending.begin(); it != pending.end();) it = flush(it);
+    blocks.close();
+    reader.join(); parser.join(); writer.join();
+
+    auto fail = [&](const string& why) {
+        for (const auto& kv : tmpFiles) remove(kv.second.c_str());
+        remove((summaries + ".tmp").c_str()); remove(txnTmp.c_str()); remove((journal + ".tmp").c_str());
+        err = why;
+        return false;
+    };
+    if (writeFailed) return fail("failed to write day partitions in " + dir);
+    st.days = static_cast<int>(fresh.size());
+    if (fresh.empty()) return true; // no closed day in the log
+    auto idx = make_shared<RollupIndex>();
+    load_summaries(dir, *idx, st.badSummaries);
+    for (const auto& kv : fresh) idx->days[kv.first].merge(kv.second);
+    if (!write_summaries(summaries + ".tmp", *idx)) return fail("failed to write " + summaries);
+
+    unique_lock<shared_mutex> logLock(txn_log_mutex, defer_lock); // waits for running reports, gates keep going
+    unique_lock<mutex> gate(gate_mutex, defer_lock);
+    if (live) { logLock.lock(); gate.lock(); }
+    long long logEnd = 0, tmpSize = 0;
+    {   // New log: header, the open day's rows, then anything gates appended while the pipeline ran.
+        ofstream ofs(txnTmp, ios::binary | ios::trunc);
+        ofs << header << "\n" << kept;
+        ifstream tail(txnPath, ios::binary); tail.seekg(limit);
+        if (tail && tail.peek() != EOF) ofs << tail.rdbuf();
+        if (!ofs.flush()) return fail("failed to write " + txnTmp);
+        tmpSize = static_cast<long long>(ofs.tellp());
+        ifstream cur(txnPath, ios::binary | ios::ate);
+        logEnd = cur ? static_cast<long long>(cur.tellg()) : limit;
+    }
+    {   // The log goes last: until it is replaced, the old log plus the published
+        // index still count every row exactly once, so a failed apply leaves
+        // reports consistent. Rows gates append meanwhile are carried over when
+        // the log line is finally applied.
+        ofstream j(journal + ".tmp", ios::binary | ios::trunc);
+        for (const auto& kv : tmpFiles) j << kv.second << "\n";
+        j << summaries << ".tmp\n" << txnTmp << ' ' << logEnd << ' ' << tmpSize << "\n";
+        if (!j.flush()) return fail("failed to write " + journal);
+    }
+    if (!replace_file(journal + ".tmp", journal)) return fail("failed to commit " + journal); // commit point
+    if (!apply_rollup_journal(journal)) { err = "rollup committed but not fully applied; it is finished on the next start"; return false; }
+    if (live) republish_rollup(txnPath, std::move(idx));
+    return true;
+}
+
+static mutex rollup_mutex; // one rollup at a time: menu, --rollup and the midnight thread
+static thread rollup_thread;
+static mutex rollup_wait_mutex;
+static condition_variable rollup_wait_cv;
+static bool rollup_stop = false;
+// The midnight thread never writes to cout/cerr itself (the main thread owns
+// them and stdio is unsynced); it queues lines here for rollup_poll().
+static mutex rollup_notice_mutex;
+static vector<pair<bool, string>> rollup_notices; // (is warning, text)
+
+static bool rollup_now(RollupStats& st, string& err) {
+    lock_guard<mutex> one(rollup_mutex);
+    return run_rollup(TRANSACTIONS_CPP, DAYS_DIR_CPP, local_clock().dayIndex(time(nullptr)), true, st, err);
+}
+
+static string rollup_summary(const RollupStats& st) {
+    string out = "Rollup: " + std::to_string(st.rolled) + " rows from " + std::to_string(st.days) + " closed day(s) moved to " + DAYS_DIR_CPP
+               + ", " + std::to_string(st.kept) + " open-day rows kept";
+    if (st.malformed) out += ", " + std::to_string(st.malformed) + " unreadable rows left in the log";
+    if (st.badSummaries) out += ", " + std::to_string(st.badSummaries) + " unreadable summary rows dropped";
+    return out + "\n";
+}
+
+static void init_rollup() {
+    if (!apply_rollup_journal(string(DAYS_DIR_CPP) + "/rollup.journal")) cerr << "Warning: could not finish the previous rollup\n";
+    auto idx = make_shared<RollupIndex>();
+    long long skipped = 0;
+    load_summaries(DAYS_DIR_CPP, *idx, skipped);
+    if (skipped) cerr << "Warning: skipped " << skipped << " malformed rows in " << DAYS_DIR_CPP << "/summaries.csv\n";
+    atomic_store(&rollup_index_ptr, shared_ptr<const RollupIndex>(std::move(idx)));
+}
+
+// Main loop: prints what the midnight thread queued since the last pass.
+static void rollup_poll() {
+    vector<pair<bool, string>> notices;
+    { lock_guard<mutex> lk(rollup_notice_mutex); notices.swap(rollup_notices); }
+    for (const auto& n : notices) (n.first ? cerr : cout) << n.second;
+}
+
+// --auto-rollup: catch up once, then roll the day that just closed shortly after each local midnight.
+static void start_auto_rollup() {
+    rollup_thread = thread([] {
+        unique_lock<mutex> lk(rollup_wait_mutex);
+        while (!rollup_stop) {
+            lk.unlock();
+            RollupStats st; string err;
+            bool ok = rollup_now(st, err);
+            if (!ok || st.days > 0) {
+                lock_guard<mutex> n(rollup_notice_mutex);
+                if (!ok) rollup_notices.emplace_back(true, "Warning: rollup failed: " + err + "\n");
+                else rollup_notices.emplace_back(false, "\n[ROLLUP] " + rollup_summary(st));
+            }
+            lk.lock();
+            const LocalClock& clock = local_clock();
+            time_t next = clock.dayStart(clock.dayIndex(time(nullptr)) + 1) + 5;
+            rollup_wait_cv.wait_until(lk, chrono::system_clock::from_time_t(next), [] { return rollup_stop; });
+        }
+    });
+}
+
+static void stop_auto_rollup() {
+    { lock_guard<mutex> lk(rollup_wait_mutex); rollup_stop = true; }
+    rollup_wait_cv.notify_all();
+    if (rollup_thread.joinable()) rollup_thread.join();
+}
+
+// ---------------- Analytics sketches ----------------
+// Fixed-size summaries updated on every exit so report screens cost the same
+// whatever the history size. All of them merge (across days and across lots).
+static uint64_t hash64(const string& key) {
+    uint64_t h = 1469598103934665603ULL; // FNV-1a, then a splitmix64 finalizer
+    for (unsigned char c : key) { h ^= c; h *= 1099511628211ULL; }
+    h ^= h >> 30; h *= 0xbf58476d1ce4e5b9ULL; h ^= h >> 27; h *= 0x94d049bb133111ebULL; h ^= h >> 31;
+    return h;
+}
+
+// Distinct count with ~1.6% standard error in 4 KB (2^12 registers).
+class HyperLogLog {
+    static const int P = 12, M = 1 << P;
+    array<uint8_t, M> reg{};
+public:
+    void add(uint64_t h) {
+        int idx = static_cast<int>(h >> (64 - P));
+        uint64_t w = h << P; uint8_t rank = 1;
+        while (rank <= 64 - P && !(w & (1ULL << 63))) { w <<= 1; ++rank; }
+        if (rank > reg[idx]) reg[idx] = rank;
+    }
+    void merge(const HyperLogLog& o) { for (int i = 0; i < M; ++i) reg[i] = max(reg[i], o.reg[i]); }
+    double estimate() const {
+        double sum = 0; int zeros = 0;
+        for (uint8_t r : reg) { sum += ldexp(1.0, -r); if (r == 0) ++zeros; }
+        double e = (0.7213 / (1.0 + 1.079 / M)) * M * M / sum;
+        if (e <= 2.5 * M && zeros > 0) e = M * log(static_cast<double>(M) / zeros); // small-range correction
+        return e;
+    }
+    string encode() const { // sparse "idx:rank" list
+        string out;
+        for (int i = 0; i < M; ++i) if (reg[i]) { if (!out.empty()) out += ';'; out += std::to_string(i) + ':' + std::to_string(reg[i]); }
+        return out.empty() ? "-" : out;
+    }
+    // False (registers unspecified) on any token that is not "idx:rank" in range.
+    bool decode(string_view in) {
+        if (in == "-") return true;
+        while (!in.empty()) {
+            size_t semi = min(in.find(';'), in.size()); string_view kv = in.substr(0, semi);
+            in.remove_prefix(min(semi + 1, in.size()));
+            size_t c = kv.find(':'); long long i = 0, r = 0;
+            if (c == string_view::npos || !parse_ll(kv.substr(0, c), i) || !parse_ll(kv.substr(c + 1), r) || i < 0 || i >= M || r < 1 || r > 64 - P + 1) return false;
+            reg[static_cast<size_t>(i)] = static_cast<uint8_t>(r);
+        }
+        return true;
+    }
+};
+
+// Quantiles with 1% relative error: log-spaced buckets (DDSketch).
+class DDSketch {
+    static constexpr double ALPHA = 0.01;
+    static const int MAX_BUCKET = 2000; // ~e^40 minutes; larger inputs land here
+    double logGamma = log((1 + ALPHA) / (1 - ALPHA));
+    vector<uint64_t> bins; // count of bucket k at bins[k]; inputs are clamped to >= 1, so k >= 0
+    uint64_t n{0};
+public:
+    void add(double x, uint64_t c = 1) {
+        if (x < 1) x = 1;
+        int k = min(MAX_BUCKET, static_cast<int>(ceil(log(x) / logGamma)));
+        if (k >= static_cast<int>(bins.size())) bins.resize(k + 1, 0);
+        bins[k] += c; n += c;
+    }
+    void merge(const DDSketch& o) {
+        if (o.bins.size() > bins.size()) bins.resize(o.bins.size(), 0);
+        for (size_t k = 0; k < o.bins.size(); ++k) bins[k] += o.bins[k];
+        n += o.n;
+    }
+    uint64_t count() const { return n; }
+    double quantile(double q) const {
+        if (n == 0) return 0;
+        uint64_t rank = static_cast<uint64_t>(q * (n - 1)), seen = 0;
+        size_t k = 0;
+        for (; k < bins.size(); ++k) { seen += bins[k]; if (seen > rank) break; }
+        if (k == bins.size()) k = bins.size() - 1;
+        return 2 * exp(static_cast<double>(k) * logGamma) / (exp(logGamma) + 1);
+    }
+    string encode() const {
+        string out;
+        for (size_t k = 0; k < bins.size(); ++k) if (bins[k]) { if (!out.empty()) out += ';'; out += std::to_string(k) + ':' + std::to_string(bins[k]); }
+        return out.empty() ? "-" : out;
+    }
+    // False on any token that is not "bucket:count" with a bucket in range and a positive count.
+    bool decode(string_view in) {
+        if (in == "-") return true;
+        while (!in.empty()) {
+            size_t semi = min(in.find(';'), in.size()); string_view kv = in.substr(0, semi);
+            in.remove_prefix(min(semi + 1, in.size()));
+            size_t c = kv.find(':'); long long k = 0, v = 0;
+            if (c == string_view::npos || !parse_ll(kv.substr(0, c), k) || !parse_ll(kv.substr(c + 1), v) || k < 0 || k > MAX_BUCKET || v <= 0) return false;
+            if (k >= static_cast<long long>(bins.size())) bins.resize(static_cast<size_t>(k) + 1, 0);
+            bins[static_cast<size_t>(k)] += static_cast<uint64_t>(v); n += static_cast<uint64_t>(v);
+        }
+        return true;
+    }
+};
+
+struct EntryHeatmap {
+    array<array<uint64_t, 24>, 7> counts{}; // [weekday 0=Sun][hour]
+    void merge(const EntryHeatmap& o) { for (int d = 0; d < 7; ++d) for (int h = 0; h < 24; ++h) counts[d][h] += o.counts[d][h]; }
+};
+
+// Published copy-on-write like LotSnapshot: an exit copies only the parts it
+// touches (today's HLL, one duration sketch, the heatmap).
+static const int SKETCH_DAYS = 56;
+
+// Writable access to one part of a sketch set. A part shared with another set
+// (e.g. the published one that sketches_record copied) is cloned first; a part
+// only this set holds (backfill, benches, merges into a private set, or one
+// already cloned for this exit) is updated in place. Parts are always created
+// non-const by make_shared, so the const_cast is safe.
+template <class T>
+static T& own_part(shared_ptr<const T>& p) {
+    if (!p) p = make_shared<T>();
+    else if (p.use_count() != 1) p = make_shared<T>(*p);
+    return const_cast<T&>(*p);
+}
+
+struct AnalyticsSketches {
+    map<long long, shared_ptr<const HyperLogLog>> daily; // local day index -> plates seen exiting
+    array<shared_ptr<const DDSketch>, VEHICLE_TYPES> durations{};
+    shared_ptr<const EntryHeatmap> heat;
+    AnalyticsSketches() {
+        for (auto& d : durations) d = make_shared<DDSketch>();
+        heat = make_shared<EntryHeatmap>();
+    }
+    void merge(const AnalyticsSketches& o) {
+        for (const auto& kv : o.daily) own_part(daily[kv.first]).merge(*kv.second);
+        while (static_cast<int>(daily.size()) > SKETCH_DAYS) daily.erase(daily.begin());
+        for (int t = 0; t < VEHICLE_TYPES; ++t) own_part(durations[t]).merge(*o.durations[t]);
+        own_part(heat).merge(*o.heat);
+    }
+    // Distinct plates over `days` local days ending at `lastDay`.
+    double uniqueOver(long long lastDay, int days) const {
+        HyperLogLog acc;
+        for (auto it = daily.lower_bound(lastDay - days + 1); it != daily.end() && it->first <= lastDay; ++it) acc.merge(*it->second);
+        return acc.estimate();
+    }
+};
+
+static shared_ptr<const AnalyticsSketches> current_sketches_ptr = make_shared<AnalyticsSketches>();
+
+static shared_ptr<const AnalyticsSketches> current_sketches() { return atomic_load(&current_sketches_ptr); }
+
+static void sketch_add(AnalyticsSketches& sk, const string& lic, VehicleType t, time_t entry, time_t exitT, long durationMin) {
+    const LocalClock& clock = local_clock();
+    long long day = clock.dayIndex(exitT);
+    own_part(sk.daily[day]).add(hash64(lic));
+    while (static_cast<int>(sk.daily.size()) > SKETCH_DAYS) sk.daily.erase(sk.daily.begin());
+    own_part(sk.durations[static_cast<int>(t)]).add(static_cast<double>(durationMin));
+    auto pe = clock.parts(entry);
+    ++own_part(sk.heat).counts[LocalClock::weekday(pe.day)][pe.hour];
+}
+
+static bool save_sketches(const AnalyticsSketches& sk, const string& path = SKETCHES_CPP) {
+    string tmp = path + ".tmp";
+    {
+        ofstream ofs(tmp);
+        if (!ofs) return false;
+        ofs << "sketches v1\n";
+        for (const auto& kv : sk.daily) ofs << "hll " << kv.first << ' ' << kv.second->encode() << "\n";
+        for (int t = 0; t < VEHICLE_TYPES; ++t) ofs << "dd " << t << ' ' << sk.durations[t]->encode() << "\n";
+        for (int d = 0; d < 7; ++d) { ofs << "heat " << d; for (auto c : sk.heat->counts[d]) ofs << ' ' << c; ofs << "\n"; }
+        if (!ofs) return false;
+    }
+    remove(path.c_str());
+    return rename(tmp.c_str(), path.c_str()) == 0;
+}
+
+// Reads a sketches file (this lot's, or another lot's for merging). Any
+// malformed line rejects the whole file and leaves `sk` untouched.
+static bool load_sketches(const string& path, AnalyticsSketches& sk) {
+    ifstream ifs(path);
+    string line;
+    if (!ifs || !getline(ifs, line) || line != "sketches v1") return false;
+    AnalyticsSketches out;
+    auto hm = make_shared<EntryHeatmap>();
+    while (getline(ifs, line)) {
+        trim(line); if (line.empty()) continue;
+        stringstream ss(line); string kind; ss >> kind;
+        bool ok = false;
+        if (kind == "hll") { long long day; string enc; auto h = make_shared<HyperLogLog>(); ok = (ss >> day >> enc) && h->decode(enc); out.daily[day] = h; }
+        else if (kind == "dd") { int t; string enc; auto d = make_shared<DDSketch>(); ok = (ss >> t >> enc) && t >= 0 && t < VEHICLE_TYPES && d->decode(enc); if (ok) out.durations[t] = d; }
+        else if (kind == "heat") { int d; ok = (ss >> d) && d >= 0 && d < 7; for (int h = 0; ok && h < 24; ++h) ok = static_cast<bool>(ss >> hm->counts[d][h]); }
+        if (!ok) return false;
+    }
+    out.heat = hm;
+    sk = std::move(out);
+    return true;
+}
+
+// Rewriting sketches.dat costs milliseconds once it holds weeks of HLLs, so an
+// exit only updates memory; sketches_poll() saves from the main loop at most
+// once a minute (outside gate_mutex) and sketches_flush() runs at shutdown.
+static const int SKETCH_SAVE_SECONDS = 60;
+static atomic<bool> sketches_dirty{false};
+static time_t sketches_saved_at = 0;
+
+// Called by the exit gate after the transaction is logged, outside gate_mutex (main thread only).
+static void sketches_record(const string& lic, VehicleType t, time_t entry, time_t exitT, long durationMin) {
+    auto next = make_shared<AnalyticsSketches>(*current_sketches());
+    sketch_add(*next, lic, t, entry, exitT, durationMin);
+    atomic_store(&current_sketches_ptr, shared_ptr<const AnalyticsSketches>(std::move(next)));
+    sketches_dirty = true;
+}
+
+static void sketches_flush() {
+    if (!sketches_dirty.exchange(false)) return;
+    sketches_saved_at = time(nullptr);
+    if (!save_sketches(*current_sketches())) { sketches_dirty = true; cerr << "Warning: failed to persist sketches\n"; }
+}
+
+static void sketches_poll() {
+    if (sketches_dirty.load() && time(nullptr) - sketches_saved_at >= SKETCH_SAVE_SECONDS) sketches_flush();
+}
+
+// Startup: load persisted sketches, or build them once from the transaction log.
+static void init_sketches() {
+    auto sk = make_shared<AnalyticsSketches>();
+    if (!load_sketches(SKETCHES_CPP, *sk)) {
+        if (ifstream(SKETCHES_CPP)) cerr << "Warning: " << SKETCHES_CPP << " is unreadable, rebuilding it from the transaction log\n";
+        bool any = false;
+        auto add = [&](const vector<string>& cols) {
+            if (cols.size() < 6) return;
+            try { sketch_add(*sk, cols[0], intToType(stoi(cols[1])), (time_t)stoll(cols[2]), (time_t)stoll(cols[3]), stol(cols[4])); any = true; } catch (...) {}
+        };
+        for (const auto& kv : rollup_index()->days) scan_csv(partition_path(DAYS_DIR_CPP, kv.first), LLONG_MAX, add);
+        scan_txns(txn_bytes, add);
+        if (any && !save_sketches(*sk)) cerr << "Warning: failed to persist sketches\n";
+    }
+    atomic_store(&current_sketches_ptr, shared_ptr<const AnalyticsSketches>(std::move(sk)));
+    sketches_saved_at = time(nullptr);
+}
+
+// ---------------- Admission (permits / blocklist) ----------------
+// data-cpp/plates.txt holds "PLATE,STATUS" lines sorted by plate (byte order),
+// STATUS one of PERMIT, BANNED, STOLEN; millions of lines are fine. The file is
+// mmap'd and fronted by a Bloom filter, so the usual "not listed" answer costs a
+// few hashed bit probes and no I/O; a Bloom hit is confirmed by binary search.
+// To refresh, write a new file and rename it over plates.txt: the main loop
+// notices the change, builds the new list on a background thread and swaps it
+// in atomically. Gates keep using the old list until then, and it is unmapped
+// when the last reader drops it.
+enum class Admission { NotListed, Permit, Banned, Stolen };
+
+// Blocked Bloom filter: all K probes for a key fall in one 64-byte block, so a
+// lookup touches a single cache line.
+class BloomFilter {
+    vector<uint64_t> words;
+    uint64_t blocks{1};
+    static const int K = 7, WORDS_PER_BLOCK = 8; // ~1-2% false positives at 10 bits per entry
+public:
+    explicit BloomFilter(size_t entries = 0) {
+        blocks = max<uint64_t>(1, (entries * 10 + 511) / 512);
+        words.assign(blocks * WORDS_PER_BLOCK, 0);
+    }
+    void add(uint64_t h) {
+        uint64_t* blk = &words[(h >> 32) % blocks * WORDS_PER_BLOCK];
+        for (int i = 0; i < K; ++i) { uint64_t b = (h >> (i * 9 % 32)) & 511; blk[b >> 6] |= 1ULL << (b & 63); h = h * 0x9E3779B97F4A7C15ULL + i; }
+    }
+    bool mayContain(uint64_t h) const {
+        const uint64_t* blk = &words[(h >> 32) % blocks * WORDS_PER_BLOCK];
+        for (int i = 0; i < K; ++i) { uint64_t b = (h >> (i * 9 % 32)) & 511; if (!(blk[b >> 6] & (1ULL << (b & 63)))) return false; h = h * 0x9E3779B97F4A7C15ULL + i; }
+        return true;
+    }
+};
+
+// Modification time and size, used to notice a replaced plates file.
+static bool file_signature(const char* path, pair<long long, long long>& sig) {
+#ifdef _WIN32
+    struct _stat st; if (_stat(path, &st) != 0) return false;
+#else
+    struct stat st; if (stat(path, &st) != 0) return false;
+#endif
+    sig = {static_cast<long long>(st.st_mtime), static_cast<long long>(st.st_size)};
+    return true;
+}
+
+class PlateList {
+    const char* data{nullptr};
+    size_t size{0};
+#ifdef _WIN32
+    string buffer; // no mmap on Windows builds: read the file into memory
+#endif
+    BloomFilter bloom;
+    size_t entries{0};
+
+    static Admission parseStatus(const char* p, const char* end) {
+        string_view st(p, static_cast<size_t>(end - p));
+        if (st == "PERMIT") return Admission::Permit;
+        if (st == "BANNED") return Admission::Banned;
+        if (st == "STOLEN") return Admission::Stolen;
+        return Admission::NotListed;
+    }
+    const char* lineEnd(const char* p) const { const char* e = static_cast<const char*>(memchr(p, '\n', data + size - p)); return e ? e : data + size; }
+public:
+    pair<long long, long long> signature{0, 0};
+    PlateList() = default;
+    PlateList(const PlateList&) = delete;
+    PlateList& operator=(const PlateList&) = delete;
+    ~PlateList() {
+#ifndef _WIN32
+        if (data && size) munmap(const_cast<char*>(data), size);
+#endif
+    }
+    size_t count() const { return entries; }
+
+    // Maps and validates a plates file; returns nullptr and sets err on failure.
+    static shared_ptr<const PlateList> open(const char* path, string& err) {
+        auto pl = make_shared<PlateList>();
+        file_signature(path, pl->signature);
+#ifdef _WIN32
+        ifstream ifs(path, ios::binary);
+        if (!ifs) { err = "cannot open " + string(path); return nullptr; }
+        pl->buffer.assign(istreambuf_iterator<char>(ifs), istreambuf_iterator<char>());
+        pl->data = pl->buffer.data(); pl->size = pl->buffer.size();
+#else
+        int fd = ::open(path, O_RDONLY);
+        if (fd < 0) { err = "cannot open " + string(path); return nullptr; }
+        struct stat st; fstat(fd, &st);
+        pl->size = static_cast<size_t>(st.st_size);
+        if (pl->size > 0) {
+            void* m = mmap(nullptr, pl->size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (m == MAP_FAILED) { ::close(fd); pl->size = 0; err = "mmap failed for " + string(path); return nullptr; }
+            pl->data = static_cast<const char*>(m);
+        }
+        ::close(fd);
+#endif
+        // One validating pass: count lines, check order and statuses, size the filter.
+        const char* p = pl->data; const char* end = pl->data + pl->size;
+        string prev; size_t lines = 0;
+        while (p < end) {
+            const char* e = pl->lineEnd(p); const char* comma = static_cast<const char*>(memchr(p, ',', e - p));
+            if (e > p) {
+                if (!comma || pl->parseStatus(comma + 1, e > p && e[-1] == '\r' ? e - 1 : e) == Admission::NotListed) { err = "bad line " + std::to_string(lines + 1); return nullptr; }
+                string key(p, comma);
+                if (lines > 0 && !(prev < key)) { err = "not sorted at line " + std::to_string(lines + 1); return nullptr; }
+                prev.swap(key); ++lines;
+            }
+            p = e + 1;
+        }
+        pl->bloom = BloomFilter(lines); pl->entries = lines;
+        for (p = pl->data; p < end; p = pl->lineEnd(p) + 1) {
+            const char* e = pl->lineEnd(p); const char* comma = static_cast<const char*>(memchr(p, ',', e - p));
+            if (comma) pl->bloom.add(hash64(string(p, comma)));
+        }
+        return pl;
+    }
+
+    Admission lookup(const string& plate) const {
+        if (entries == 0 || !bloom.mayContain(hash64(plate))) return Admission::NotListed;
+        size_t lo = 0, hi = size; // search over [lo, hi) byte range, aligned to line starts
+        while (lo < hi) {
+            size_t mid = lo + (hi - lo) / 2;
+            while (mid > lo && data[mid - 1] != '\n') --mid;
+            const char* e = lineEnd(data + mid);
+            const char* comma = static_cast<const char*>(memchr(data + mid, ',', e - (data + mid)));
+            if (!comma) { lo = static_cast<size_t>(e - data) + 1; continue; } // blank line
+            int c = string_view(data + mid, static_cast<size_t>(comma - (data + mid))).compare(plate);
+            if (c == 0) return parseStatus(comma + 1, e > comma && e[-1] == '\r' ? e - 1 : e);
+            if (c < 0) lo = static_cast<size_t>(e - data) + 1; else hi = mid;
+        }
+        return Admission::NotListed;
+    }
+};
+
+static shared_ptr<const PlateList> plate_list_ptr = make_shared<PlateList>();
+static thread plate_reload_thread;
+static atomic<bool> plate_reload_running{false};
+static pair<long long, long long> plate_tried_signature{0, 0}; // last file version attempted, good or bad
+// The reload thread does not print; a failed load is queued here for admission_poll().
+static mutex plate_notice_mutex;
+static vector<string> plate_notices;
+
+static Admission admission_check(const string& plate) {
+    return atomic_load(&plate_list_ptr)->lookup(plate);
+}
+
+static bool plates_load_now(string& err) {
+    file_signature(PLATES_CPP, plate_tried_signature);
+    auto pl = PlateList::open(PLATES_CPP, err);
+    if (pl) atomic_store(&plate_list_ptr, pl);
+    return static_cast<bool>(pl);
+}
+
+// Main-loop hook: report a failed reload, and start a background reload when
+// plates.txt was replaced.
+static void admission_poll() {
+    vector<string> notices;
+    { lock_guard<mutex> lk(plate_notice_mutex); notices.swap(plate_notices); }
+    for (const auto& n : notices) cerr << "Warning: plate list not loaded: " << n << "\n";
+    if (plate_reload_thread.joinable() && !plate_reload_running.load()) plate_reload_thread.join();
+    if (plate_reload_running.load()) return;
+    pair<long long, long long> sig;
+    if (!file_signature(PLATES_CPP, sig) || sig == plate_tried_signature) return;
+    plate_reload_running = true;
+    plate_reload_thread = thread([] {
+        string err;
+        if (!plates_load_now(err)) { lock_guard<mutex> lk(plate_notice_mutex); plate_notices.push_back(err); }
+        plate_reload_running = false;
+    });
+}
+
+static pair<bool,pair<int,int>> find_vehicle(const string& lic) {
+    auto pos = lot.find(lic);
+    return {pos.first >= 0, pos};
+}
+
 static int ask_int(const string& prompt) {
     cout << prompt; string line; getline(cin, line); trim(line); try { return stoi(line); } catch (...) { throw runtime_error("Invalid number"); }
 }
@@ -234,22 +1946,28 @@ static void menu_entry() {
         int type = ask_int("> ");
         string lic = ask_str("License plate: ");
         if (find_vehicle(lic).first) throw runtime_error("Vehicle already parked");
+        Admission adm = admission_check(lic);
+        if (adm == Admission::Banned) throw runtime_error("Entry denied: plate is banned");
+        if (adm == Admission::Stolen) throw runtime_error("Entry denied: plate reported stolen, notify security");
         string own = ask_str("Owner contact/name: ");
-        auto pos = find_nearest_spot(); if (pos.first < 0) throw runtime_error("Parking full");
+        int prepaidHours = ask_int("Prepaid hours (0 for none): ");
+        if (prepaidHours < 0 || prepaidHours > MAX_STAY_MINUTES / 60) throw runtime_error("Prepaid hours must be between 0 and " + to_string(MAX_STAY_MINUTES / 60));
         auto v = make_vehicle(type, lic, own);
-        v->setPosition(pos.first, pos.second);
+        if (prepaidHours > 0) v->setPrepaidUntil(v->getEntryTime() + prepaidHours * 3600LL);
+        Money prepaid = prepaid_amount(*v);
+        lock_guard<mutex> gate(gate_mutex);
+        auto pos = find_nearest_spot(); if (pos.first < 0) throw runtime_error("Parking full");
         
         // Display entry time
-        time_t entry = v->getEntryTime();
-        char entryBuf[64];
-        tm te = *localtime(&entry);
-        strftime(entryBuf, sizeof(entryBuf), "%Y-%m-%d %H:%M:%S", &te);
+        string entryBuf = local_clock().format(v->getEntryTime());
+        time_t prepaidUntil = v->getPrepaidUntil();
         
-        lot[pos.first][pos.second].occupied = true;
-        lot[pos.first][pos.second].vehicle = std::move(v);
+        gate_park(pos.first, pos.second, std::move(v));
         if (!save_state()) cerr << "Warning: failed to persist state\n";
         cout << "Assigned Floor " << (pos.first+1) << ", Spot " << (pos.second+1) << "\n";
         cout << "Entry time: " << entryBuf << "\n";
+        if (adm == Admission::Permit) cout << "Monthly permit holder\n";
+        if (prepaidHours > 0) cout << "Prepaid: " << prepaid << " until " << local_clock().format(prepaidUntil) << "\n";
     } catch (const exception& e) {
         cout << "Error: " << e.what() << "\n";
     }
@@ -259,23 +1977,29 @@ static void menu_exit() {
     try {
         cout << "\n=== Vehicle Exit ===\n";
         string lic = ask_str("Enter license plate: ");
+        unique_lock<mutex> gate(gate_mutex);
         auto pos = find_vehicle(lic); if (!pos.first) throw runtime_error("Not found");
         int f = pos.second.first, s = pos.second.second;
-        auto& ps = lot[f][s];
-        auto& v = ps.vehicle;
+        auto& v = lot.at(f, s).vehicle;
         time_t now = time(nullptr);
         long durationMin = max(1L, (long)difftime(now, v->getEntryTime()) / 60);
-        double fee = v->calcFee(durationMin);
+        Money fee = lot.fee(v->getType(), durationMin);
+        Money prepaid = prepaid_amount(*v);
+        Money total = fee < prepaid ? prepaid : fee; // an unused prepaid window is not refunded
         time_t entryT = v->getEntryTime();
-        char eb[64], xb[64]; tm te = *localtime(&entryT); tm tx = *localtime(&now);
-        strftime(eb, sizeof(eb), "%Y-%m-%d %H:%M:%S", &te);
-        strftime(xb, sizeof(xb), "%Y-%m-%d %H:%M:%S", &tx);
+        string xb = local_clock().format(now);
         cout << "--- Receipt ---\n";
         cout << *v << "\n";
-        cout << "Exit=" << xb << ", Duration=" << durationMin << " min, Fee=" << fixed << setprecision(2) << fee << "\n";
-        if (!append_txn(v->getLicense(), v->getType(), v->getEntryTime(), now, durationMin, fee)) cerr << "Warning: failed to record transaction\n";
-        ps.occupied = false; ps.vehicle.reset();
+        cout << "Exit=" << xb << ", Duration=" << durationMin << " min, Fee=" << fee << "\n";
+        if (prepaid != Money()) cout << "Prepaid=" << prepaid << ", Due=" << (total - prepaid) << "\n";
+        auto ov = overstays.find(lic);
+        if (ov != overstays.end()) cout << "Overstayed by " << (static_cast<long long>(now) / 60 - ov->second.deadlineMinute) << " min\n";
+        if (!append_txn(v->getLicense(), v->getType(), v->getEntryTime(), now, durationMin, total, prepaid)) cerr << "Warning: failed to record transaction\n";
+        VehicleType vt = v->getType();
+        gate_release(f, s, now);
         if (!save_state()) cerr << "Warning: failed to persist state\n";
+        gate.unlock(); // sketches are main-thread only and published copy-on-write
+        sketches_record(lic, vt, entryT, now, durationMin);
     } catch (const exception& e) {
         cout << "Error: " << e.what() << "\n";
     }
@@ -288,65 +2012,699 @@ static void menu_search() {
         auto pos = find_vehicle(lic);
         if (!pos.first) { cout << "Not found\n"; return; }
         int f = pos.second.first, s = pos.second.second;
-        auto& v = lot[f][s].vehicle;
+        auto& v = lot.at(f, s).vehicle;
         cout << "Found at Floor " << (f+1) << ", Spot " << (s+1) << ": " << *v << "\n";
     } catch (const exception& e) { cout << "Error: " << e.what() << "\n"; }
 }
 
 static void report_occupancy() {
+    auto snap = current_snapshot();
     cout << "\n=== Occupancy Report ===\n";
     int totalOcc = 0;
     for (int f=0; f<FLOORS; ++f) {
-        int occ=0; for (int s=0; s<SPOTS_PER_FLOOR; ++s) if (lot[f][s].occupied) ++occ;
+        int occ = snap->floors[f]->occupied;
         totalOcc += occ; double rate = 100.0*occ/SPOTS_PER_FLOOR; cout << "Floor " << (f+1) << ": " << occ << "/" << SPOTS_PER_FLOOR << " (" << fixed << setprecision(1) << rate << "%)\n";
     }
     cout << "Overall: " << totalOcc << "/" << FLOORS*SPOTS_PER_FLOOR << " (" << fixed << setprecision(1) << 100.0*totalOcc/(FLOORS*SPOTS_PER_FLOOR) << "%)\n";
 }
 
-static void report_revenue() {
-    ifstream ifs(TRANSACTIONS_CPP);
-    if (!ifs) { cout << "No transactions yet.\n"; return; }
-    string line; if (!getline(ifs, line)) { cout << "No transactions yet.\n"; return; }
-    double total=0.0, today=0.0;
-    time_t now = time(nullptr); tm tn = *localtime(&now);
-    while (getline(ifs, line)) {
-        if (line.empty()) continue;
-        stringstream ss(line); string col; vector<string> cols; while (getline(ss,col,',')) cols.push_back(col);
-        if (cols.size()<6) continue;
-    long long exitTll = stoll(cols[3]); double fee = stod(cols[5]); total += fee; time_t exitT = (time_t)exitTll; tm tx = *localtime(&exitT);
-        if (tx.tm_year==tn.tm_year && tx.tm_mon==tn.tm_mon && tx.tm_mday==tn.tm_mday) today += fee;
+static void report_occupancy_history() {
+    cout << "\n=== Occupancy History (last 24h) ===\n";
+    time_t now = time(nullptr);
+    auto samples = occ_history.window(now, HISTORY_MINUTES);
+    const int cap = FLOORS * SPOTS_PER_FLOOR;
+    const LocalClock& clock = local_clock();
+    // Local hour bucket (day * 24 + hour): UTC hours split half-hour zones such as IST.
+    auto local_hour = [&](long long minute) { auto p = clock.parts((time_t)(minute * 60)); return p.day * 24 + p.hour; };
+    bool any = false;
+    size_t i = 0;
+    while (i < samples.size()) {
+        if (!samples[i].valid()) { ++i; continue; }
+        long long hour = local_hour(samples[i].minute), sum = 0; int n = 0, peak = 0;
+        for (; i < samples.size() && samples[i].valid() && local_hour(samples[i].minute) == hour; ++i) { sum += samples[i].total; peak = max(peak, samples[i].peak); ++n; }
+        any = true;
+        int h = static_cast<int>(hour - (hour / 24) * 24);
+        string buf = LocalClock::formatDate(hour / 24).substr(5) + (h < 10 ? " 0" : " ") + std::to_string(h) + ":00"; // "MM-DD HH:00"
+        cout << buf << "  avg " << fixed << setprecision(1) << 100.0 * sum / n / cap << "%  peak " << peak << "/" << cap << "\n";
     }
-    cout << fixed << setprecision(2) << "Revenue (today): " << today << "\nRevenue (total): " << total << "\n";
+    if (!any) { cout << "No history recorded yet.\n"; return; }
+    int full = occ_history.minutesFull(now, HISTORY_MINUTES);
+    auto cur = samples.back();
+    cout << "Minutes at 100% full: " << full << "\n";
+    cout << "Now: " << cur.total << "/" << cap << " (Bike " << cur.types[0] << ", Car " << cur.types[1] << ", Truck " << cur.types[2] << ")\n";
+}
+
+static void report_overstays() {
+    deadline_tick(time(nullptr));
+    vector<DeadlineEvent> rows;
+    {
+        lock_guard<mutex> gate(gate_mutex);
+        for (const auto& kv : overstays) rows.push_back(kv.second);
+    }
+    cout << "\n=== Overstays ===\n";
+    if (rows.empty()) { cout << "No vehicles over the maximum stay (" << MAX_STAY_MINUTES / 60 << "h) or their prepaid window.\n"; return; }
+    sort(rows.begin(), rows.end(), [](const DeadlineEvent& a, const DeadlineEvent& b) { return a.deadlineMinute < b.deadlineMinute; });
+    long long nowMin = static_cast<long long>(time(nullptr)) / 60;
+    for (const auto& ev : rows) {
+        cout << ev.license << " at Floor " << (ev.floor+1) << ", Spot " << (ev.spot+1) << ": over by " << (nowMin - ev.deadlineMinute) << " min" << (ev.prepaid ? " (prepaid window)" : "") << "\n";
+    }
+    cout << "Total: " << rows.size() << "\n";
+}
+
+// Closed days come from the rollup summaries; only the open day is scanned raw.
+// txn_log_mutex keeps the log on disk the one the snapshot's summaries describe.
+static void report_revenue() {
+    shared_lock<shared_mutex> log(txn_log_mutex);
+    auto snap = current_snapshot();
+    const auto& idx = snap->days;
+    if (snap->txnBytes == 0 && idx->days.empty()) { cout << "No transactions yet.\n"; return; }
+    vector<long long> exitTimes, cents;
+    scan_txns(snap->txnBytes, [&](const vector<string>& cols) {
+        Money fee;
+        if (cols.size()<6 || !Money::parse(cols[5], fee)) return;
+        exitTimes.push_back(stoll(cols[3])); cents.push_back(fee.cents());
+    });
+    const LocalClock& clock = local_clock();
+    long long todayIdx = clock.dayIndex(time(nullptr));
+    long long dayStart = static_cast<long long>(clock.dayStart(todayIdx)), dayEnd = static_cast<long long>(clock.dayStart(todayIdx + 1));
+    long long closedCents = 0, closedToday = 0;
+    for (auto c : idx->total().revenueCents) closedCents += c;
+    auto it = idx->days.find(todayIdx); // only if the clock went backwards after a rollup
+    if (it != idx->days.end()) for (auto c : it->second.revenueCents) closedToday += c;
+    Money total = Money::fromCents(closedCents + sum_cents(cents.data(), cents.size()));
+    Money today = Money::fromCents(closedToday + sum_cents_between(exitTimes.data(), cents.data(), cents.size(), dayStart, dayEnd));
+    cout << "Revenue (today): " << today << "\nRevenue (total): " << total << "\n";
 }
 
 static void report_peak_entry_hour() {
     array<int,24> counts{}; counts.fill(0);
-    ifstream ifs(TRANSACTIONS_CPP);
-    string line; if (ifs && getline(ifs, line)) {
-        while (getline(ifs, line)) {
-            if (line.empty()) continue; stringstream ss(line); string col; vector<string> cols; while (getline(ss,col,',')) cols.push_back(col); if (cols.size()<3) continue; long long entryll = stoll(cols[2]); time_t entry = (time_t)entryll; tm te = *localtime(&entry); int h = te.tm_hour; if (h>=0 && h<24) counts[h]++;
-        }
-    }
-    for (int f=0; f<FLOORS; ++f) for (int s=0; s<SPOTS_PER_FLOOR; ++s) if (lot[f][s].occupied && lot[f][s].vehicle) { time_t et = lot[f][s].vehicle->getEntryTime(); tm te = *localtime(&et); int h = te.tm_hour; if (h>=0 && h<24) counts[h]++; }
+    shared_lock<shared_mutex> log(txn_log_mutex);
+    auto snap = current_snapshot();
+    const LocalClock& clock = local_clock();
+    scan_txns(snap->txnBytes, [&](const vector<string>& cols) {
+        if (cols.size()<3) return; long long entryll = stoll(cols[2]); int h = clock.hour((time_t)entryll); if (h>=0 && h<24) counts[h]++;
+    });
+    for (const auto& fl : snap->floors) for (const auto& sv : fl->spots) if (sv.occupied) { int h = clock.hour(sv.entryTime); if (h>=0 && h<24) counts[h]++; }
+    auto closed = snap->days->total();
+    for (int h=0; h<24; ++h) counts[h] += static_cast<int>(closed.entriesByHour[h]);
     int maxHour = 0, maxCount = counts[0]; for (int h=1; h<24; ++h) if (counts[h]>maxCount) { maxCount=counts[h]; maxHour=h; }
     cout << "\n=== Peak Entry Hour ===\n"; if (maxCount==0) cout << "No data available yet.\n"; else cout << "Busiest entry hour: " << setw(2) << setfill('0') << maxHour << ":00-" << setw(2) << (maxHour+1)%24 << ":00 with " << setfill(' ') << maxCount << " entries\n";
 }
 
+static void report_unique_vehicles() {
+    auto sk = current_sketches();
+    long long today = local_clock().dayIndex(time(nullptr));
+    cout << "\n=== Unique Vehicles (estimated) ===\n";
+    if (sk->daily.empty()) { cout << "No data available yet.\n"; return; }
+    for (int d = 6; d >= 0; --d) {
+        auto it = sk->daily.find(today - d);
+        cout << LocalClock::formatDate(today - d) << ": " << (it == sk->daily.end() ? 0 : llround(it->second->estimate())) << "\n";
+    }
+    cout << "Last 7 days: " << llround(sk->uniqueOver(today, 7)) << "\nLast 28 days: " << llround(sk->uniqueOver(today, 28)) << "\n";
+}
+
+static void report_duration_percentiles() {
+    auto sk = current_sketches();
+    cout << "\n=== Parking Duration (minutes) ===\n";
+    const char* names[VEHICLE_TYPES] = {"Bike", "Car", "Truck"};
+    for (int t = 0; t < VEHICLE_TYPES; ++t) {
+        const auto& d = *sk->durations[t];
+        cout << left << setw(6) << names[t] << right;
+        if (d.count() == 0) { cout << " no sessions\n"; continue; }
+        cout << fixed << setprecision(0) << " p50 " << d.quantile(0.5) << "  p90 " << d.quantile(0.9) << "  p99 " << d.quantile(0.99) << "  (" << d.count() << " sessions)\n";
+    }
+}
+
+static void report_entry_heatmap() {
+    auto sk = current_sketches();
+    const auto& c = sk->heat->counts;
+    uint64_t mx = 0; for (const auto& row : c) for (auto v : row) mx = max(mx, v);
+    cout << "\n=== Entry Heatmap (hour of week) ===\n";
+    if (mx == 0) { cout << "No data available yet.\n"; return; }
+    const char* days[7] = {"Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat"};
+    cout << "     "; for (int h = 0; h < 24; ++h) cout << setw(3) << h; cout << "\n";
+    for (int d = 0; d < 7; ++d) {
+        cout << days[d] << "  ";
+        for (int h = 0; h < 24; ++h) {
+            if (c[d][h] == 0) { cout << "  ."; continue; }
+            cout << setw(3) << (1 + (c[d][h] * 8) / mx); // 1..9 relative to the busiest hour
+        }
+        cout << "\n";
+    }
+    cout << "Scale: 1-9 relative to the busiest hour (" << mx << " entries)\n";
+}
+
+// --merge-sketches FILE...: chain-wide view. Merges other lots' sketches.dat
+// files into this lot's and prints the sketch reports; nothing is saved.
+static int merge_sketches_report(const vector<string>& files) {
+    auto chain = make_shared<AnalyticsSketches>();
+    if (!load_sketches(SKETCHES_CPP, *chain)) cerr << "Warning: no sketches for this lot (" << SKETCHES_CPP << ")\n";
+    int merged = 0;
+    for (const auto& f : files) {
+        AnalyticsSketches other;
+        if (!load_sketches(f, other)) { cerr << "Warning: skipping " << f << " (missing or not a sketches file)\n"; continue; }
+        chain->merge(other); ++merged;
+    }
+    atomic_store(&current_sketches_ptr, shared_ptr<const AnalyticsSketches>(std::move(chain)));
+    cout << "Merged " << merged << " other lot(s)\n";
+    report_unique_vehicles();
+    report_duration_percentiles();
+    report_entry_heatmap();
+    return merged == static_cast<int>(files.size()) ? 0 : 1;
+}
+
+static void menu_allocation() {
+    while (true) {
+        cout << "\n=== Allocation Settings ===\nCurrent policy: " << spot_allocator->name() << "\nClosed floors:";
+        bool any = false;
+        for (int f = 0; f < FLOORS; ++f) if (spot_allocator->floorClosed(f)) { cout << ' ' << (f+1); any = true; }
+        cout << (any ? "\n" : " none\n");
+        int n = strategy_count();
+        for (int i = 0; i < n; ++i) cout << (i+1) << ". " << strategy_name(i) << "\n";
+        cout << (n+1) << ". Open/close a floor\n" << (n+2) << ". Back\n";
+        try {
+            int ch = ask_int("> ");
+            if (ch >= 1 && ch <= n) { use_strategy(make_strategy(ch - 1)); if (!save_allocation()) cerr << "Warning: failed to persist allocation settings\n"; }
+            else if (ch == n+1) {
+                int f = ask_int("Floor (1-" + std::to_string(FLOORS) + "): ");
+                if (f < 1 || f > FLOORS) throw runtime_error("Invalid floor");
+                spot_allocator->setFloorClosed(f-1, !spot_allocator->floorClosed(f-1));
+                cout << "Floor " << f << (spot_allocator->floorClosed(f-1) ? " closed" : " opened") << " for new arrivals\n";
+                if (!save_allocation()) cerr << "Warning: failed to persist allocation settings\n";
+            }
+            else if (ch == n+2) break;
+            else cout << "Invalid choice\n";
+        } catch (const exception& e) { cout << "Error: " << e.what() << "\n"; }
+    }
+}
+
 static void reports_menu() {
     while (true) {
-        cout << "\n=== Reports ===\n1. Occupancy\n2. Revenue\n3. Peak Entry Hour\n4. Back\n> ";
+        cout << "\n=== Reports ===\n1. Occupancy\n2. Revenue\n3. Peak Entry Hour\n4. Occupancy History (24h)\n5. Overstays\n6. Unique Vehicles\n7. Duration Percentiles\n8. Entry Heatmap\n9. Back\n> ";
         string line; getline(cin, line); trim(line); if (line.empty()) continue; int ch = stoi(line);
-        if (ch==1) report_occupancy(); else if (ch==2) report_revenue(); else if (ch==3) report_peak_entry_hour(); else if (ch==4) break; else cout << "Invalid choice\n";
+        if (ch==1) report_occupancy(); else if (ch==2) report_revenue(); else if (ch==3) report_peak_entry_hour(); else if (ch==4) report_occupancy_history(); else if (ch==5) report_overstays(); else if (ch==6) report_unique_vehicles(); else if (ch==7) report_duration_percentiles(); else if (ch==8) report_entry_heatmap(); else if (ch==9) break; else cout << "Invalid choice\n";
+    }
+}
+
+// ---------------- Benchmarks (--bench <name>) ----------------
+// Never touch data-cpp files; scratch files go in the current directory.
+static double elapsed_ns(chrono::steady_clock::time_point t0) {
+    return static_cast<double>(chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - t0).count());
+}
+
+// Allocation cost per policy on a large garage at 95% occupancy: each op frees
+// a random spot and allocates the next one.
+static void bench_alloc() {
+    const int fl = 50, sp = 2000, n = fl * sp, ops = 200000;
+    auto geo = default_geometry(fl, sp);
+    vector<long long> rowMajor(n); for (int i = 0; i < n; ++i) rowMajor[i] = i;
+    vector<pair<string, unique_ptr<AllocationStrategy>>> policies;
+    policies.emplace_back("nearest", make_unique<DistanceStrategy>("nearest", fl, sp, rowMajor));
+    policies.emplace_back("entrance", make_unique<DistanceStrategy>("entrance", fl, sp, geo[0].cost));
+    policies.emplace_back("elevator", make_unique<DistanceStrategy>("elevator", fl, sp, geo[1].cost));
+    policies.emplace_back("fill-evenly", make_unique<FillEvenlyStrategy>(fl, sp));
+    policies.emplace_back("nearest+10 closed", make_unique<DistanceStrategy>("nearest", fl, sp, rowMajor));
+    for (int f = 0; f < 10; ++f) policies.back().second->setFloorClosed(f, true);
+    cout << "Allocation benchmark: " << fl << " floors x " << sp << " spots, 95% full, " << ops << " release+allocate ops\n";
+    {   // Baseline: the old row-major linear scan.
+        vector<char> freeSpot(n, 1); vector<int> used; mt19937 rng(7);
+        for (int i = 0; i < n * 95 / 100; ++i) { freeSpot[i] = 0; used.push_back(i); }
+        auto t0 = chrono::steady_clock::now();
+        for (int k = 0; k < ops; ++k) {
+            size_t j = rng() % used.size(); freeSpot[used[j]] = 1; used[j] = used.back(); used.pop_back();
+            int i = 0; while (i < n && !freeSpot[i]) ++i;
+            freeSpot[i] = 0; used.push_back(i);
+        }
+        cout << "  " << left << setw(20) << "linear scan" << right << setw(10) << fixed << setprecision(1) << elapsed_ns(t0) / ops << " ns/op\n";
+    }
+    for (auto& p : policies) {
+        auto& st = *p.second; vector<pair<int,int>> used; mt19937 rng(7);
+        for (int i = 0; i < n * 95 / 100; ++i) { auto pos = st.pick(); if (pos.first < 0) break; st.occupy(pos.first, pos.second); used.push_back(pos); }
+        auto t0 = chrono::steady_clock::now();
+        for (int k = 0; k < ops; ++k) {
+            size_t j = rng() % used.size(); st.release(used[j].first, used[j].second); used[j] = used.back(); used.pop_back();
+            auto pos = st.pick(); st.occupy(pos.first, pos.second); used.push_back(pos);
+        }
+        cout << "  " << left << setw(20) << p.first << right << setw(10) << fixed << setprecision(1) << elapsed_ns(t0) / ops << " ns/op\n";
+    }
+}
+
+// Gate latency while a long report runs: against snapshots (no gate lock) and,
+// for contrast, the old way of reading `lot` under the gate lock. Fails unless
+// gate p99 with a snapshot report stays within 1.5x + 1 us of the no-report run
+// and no gate operation ever found the lock held by the report. The second
+// check holds on any core count; p99 alone cannot show the lock variant's
+// blocking on one core, where the report is simply preempted.
+static bool bench_snapshot() {
+    geometry = default_geometry(FLOORS, SPOTS_PER_FLOOR);
+    use_strategy(make_strategy(0));
+    deadline_wheel.start(static_cast<long long>(time(nullptr)) / 60);
+    publish_all();
+    // The reader runs the real menu reports; their output goes nowhere. Only the
+    // reader prints while cout is redirected.
+    struct NullBuf : streambuf { int overflow(int c) override { return c; } } nullBuf;
+    auto reports_once = [] { report_occupancy(); report_revenue(); report_peak_entry_hour(); };
+    auto run_gate = [](int ops, long long& contended) {
+        vector<double> lat; lat.reserve(ops); mt19937 rng(11); vector<pair<int,int>> parked; long long serial = 0;
+        contended = 0;
+        for (int k = 0; k < ops; ++k) {
+            auto t0 = chrono::steady_clock::now();
+            {
+                unique_lock<mutex> gate(gate_mutex, try_to_lock);
+                if (!gate.owns_lock()) { ++contended; gate.lock(); }
+                bool park = parked.empty() || (parked.size() < 90 && rng() % 2 == 0);
+                if (park) {
+                    auto pos = find_nearest_spot();
+                    gate_park(pos.first, pos.second, make_unique<Car>("B" + std::to_string(serial++), "bench", VehicleType::Car));
+                    parked.push_back(pos);
+                } else {
+                    size_t j = rng() % parked.size();
+                    gate_release(parked[j].first, parked[j].second, time(nullptr));
+                    parked[j] = parked.back(); parked.pop_back();
+                }
+            }
+            lat.push_back(elapsed_ns(t0) / 1000.0);
+        }
+        for (auto& p : parked) { lock_guard<mutex> gate(gate_mutex); gate_release(p.first, p.second, time(nullptr)); }
+        sort(lat.begin(), lat.end());
+        return lat;
+    };
+    auto p99 = [](const vector<double>& lat) { return lat[lat.size() * 99 / 100]; };
+    auto print = [&](const string& label, const vector<double>& lat, long long reports, long long contended) {
+        cout << "  " << left << setw(26) << label << right << fixed << setprecision(2)
+             << "p50 " << setw(8) << lat[lat.size() / 2] << " us  p99 " << setw(8) << p99(lat)
+             << " us  max " << setw(9) << lat.back() << " us  reports " << setw(5) << reports << "  gate waits " << contended << "\n";
+    };
+    const int ops = 200000;
+    cout << "Gate latency, " << ops << " entry/exit ops per run\n";
+    long long contended = 0;
+    auto base = run_gate(ops, contended);
+    print("no report", base, 0, contended);
+    double snapP99 = 0; long long snapWaits = 0, snapReports = 0;
+    for (int mode = 0; mode < 2; ++mode) {
+        atomic<bool> stop{false}; atomic<long long> reports{0};
+        streambuf* out = cout.rdbuf(&nullBuf);
+        thread reader([&] {
+            while (!stop.load()) {
+                if (mode == 0) reports_once();
+                else { lock_guard<mutex> gate(gate_mutex); reports_once(); } // pre-snapshot behaviour; no rollup runs here, so taking txn_log_mutex inside is safe
+                ++reports;
+            }
+        });
+        auto lat = run_gate(ops, contended);
+        stop = true; reader.join();
+        cout.rdbuf(out);
+        print(mode == 0 ? "report on snapshot" : "report under gate lock", lat, reports.load(), contended);
+        if (mode == 0) { snapP99 = p99(lat); snapWaits = contended; snapReports = reports.load(); }
+    }
+    bool ok = snapReports > 0 && snapWaits == 0 && snapP99 <= p99(base) * 1.5 + 1.0;
+    cout << (ok ? "PASS\n" : "FAIL\n");
+    return ok;
+}
+
+// 10M synthetic sessions billed by ParkingLot::fee: the integer revenue path must match an independently
+// computed exact total after a round trip through the CSV text format; the old
+// stod/double path is timed alongside to show its cost and drift.
+static bool bench_money() {
+    const size_t n = 10000000;
+    const long long rateCents[VEHICLE_TYPES][2] = {{2000, 1000}, {4000, 2000}, {6000, 3000}};
+    const long maxMinutes = 72 * 60;
+    vector<long long> cents(n);
+    vector<vector<long long>> hoursHist(VEHICLE_TYPES, vector<long long>(maxMinutes / 60 + 2, 0));
+    mt19937_64 rng(2024);
+    long long badText = 0; double dblTotal = 0.0; double tParseMoney = 0, tParseDouble = 0;
+    for (size_t i = 0; i < n; ++i) {
+        int t = static_cast<int>(rng() % VEHICLE_TYPES);
+        long minutes = 1 + static_cast<long>(rng() % maxMinutes);
+        string txt = decltype(lot)::fee(intToType(t), minutes).str(); // what menu_exit bills and append_txn writes
+        ++hoursHist[t][max(1L, (minutes + 59) / 60)];
+        auto t0 = chrono::steady_clock::now();
+        Money m; if (!Money::parse(txt, m)) ++badText;
+        cents[i] = m.cents();
+        tParseMoney += elapsed_ns(t0);
+        t0 = chrono::steady_clock::now();
+        dblTotal += stod(txt);
+        tParseDouble += elapsed_ns(t0);
+    }
+    long long expected = 0;
+    for (int t = 0; t < VEHICLE_TYPES; ++t)
+        for (size_t h = 1; h < hoursHist[t].size(); ++h) expected += hoursHist[t][h] * (rateCents[t][0] + rateCents[t][1] * static_cast<long long>(h - 1));
+    auto t0 = chrono::steady_clock::now();
+    long long total = sum_cents(cents.data(), cents.size());
+    double tSum = elapsed_ns(t0);
+    bool ok = badText == 0 && total == expected;
+    cout << "Revenue over " << n << " synthetic sessions\n"
+         << "  expected (closed form) " << Money::fromCents(expected) << "\n"
+         << "  integer cents          " << Money::fromCents(total) << (total == expected ? "  exact" : "  MISMATCH") << "\n"
+         << "  double (old path)      " << fixed << setprecision(2) << dblTotal << "  off by " << setprecision(6) << (dblTotal - expected / 100.0) << "\n"
+         << setprecision(1)
+         << "  parse: Money::parse " << tParseMoney / n << " ns/row, stod " << tParseDouble / n << " ns/row (timer overhead included)\n"
+         << "  sum_cents: " << tSum / 1e6 << " ms for " << n << " rows\n"
+         << (ok ? "PASS\n" : "FAIL\n");
+    return ok;
+}
+
+// Peak-hour style scan over 2M synthetic rows spanning three years: per-row
+// localtime() (the old report code) against LocalClock. Also cross-checks every
+// LocalClock result against localtime_r; run with e.g. TZ=America/New_York to
+// cover DST transitions.
+static bool bench_timescan() {
+    const size_t n = 2000000;
+    const LocalClock& clock = local_clock();
+    long long now = static_cast<long long>(time(nullptr));
+    mt19937_64 rng(5);
+    vector<long long> times(n); vector<string> rows(n);
+    for (size_t i = 0; i < n; ++i) {
+        times[i] = now - static_cast<long long>(rng() % (3ULL * 365 * 86400));
+        rows[i] = "P" + std::to_string(i % 5000) + ",1," + std::to_string(times[i]) + "," + std::to_string(times[i] + 3600) + ",60,40.00";
+    }
+    long long mismatches = 0;
+    for (size_t i = 0; i < n; ++i) {
+        time_t t = static_cast<time_t>(times[i]); tm lt{};
+#ifdef _WIN32
+        localtime_s(&lt, &t);
+#else
+        localtime_r(&t, &lt);
+#endif
+        auto p = clock.parts(t);
+        if (p.day != days_from_civil(lt.tm_year + 1900, lt.tm_mon + 1, lt.tm_mday) || p.hour != lt.tm_hour || p.minute != lt.tm_min || LocalClock::weekday(p.day) != lt.tm_wday) ++mismatches;
+    }
+    auto scan = [&](bool cached) {
+        array<long long, 24> counts{};
+        auto t0 = chrono::steady_clock::now();
+        for (const auto& line : rows) {
+            stringstream ss(line); string col; vector<string> cols; while (getline(ss, col, ',')) cols.push_back(col);
+            time_t entry = (time_t)stoll(cols[2]);
+            int h = cached ? clock.hour(entry) : localtime(&entry)->tm_hour;
+            counts[h]++;
+        }
+        return make_pair(elapsed_ns(t0) / 1e6, counts);
+    };
+    auto bucket = [&](bool cached) {
+        long long sink = 0;
+        auto t0 = chrono::steady_clock::now();
+        for (long long t : times) { time_t tt = (time_t)t; sink += cached ? clock.hour(tt) : localtime(&tt)->tm_hour; }
+        return make_pair(elapsed_ns(t0) / n, sink);
+    };
+    auto oldScan = scan(false), newScan = scan(true);
+    auto oldB = bucket(false), newB = bucket(true);
+    auto t0 = chrono::steady_clock::now();
+    size_t chars = 0; for (size_t i = 0; i < 200000; ++i) chars += clock.format((time_t)times[i]).size();
+    double fmtNs = elapsed_ns(t0) / 200000;
+    char buf[64]; t0 = chrono::steady_clock::now();
+    for (size_t i = 0; i < 200000; ++i) { time_t tt = (time_t)times[i]; chars += strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", localtime(&tt)); }
+    double fmtOldNs = elapsed_ns(t0) / 200000;
+    bool ok = mismatches == 0 && oldScan.second == newScan.second && oldB.second == newB.second;
+    volatile size_t sink = chars; (void)sink;
+    cout << "Local-time bucketing, " << n << " rows over 3 years\n" << fixed << setprecision(1)
+         << "  mismatches vs localtime_r: " << mismatches << "\n"
+         << "  epoch -> hour:        localtime " << oldB.first << " ns, LocalClock " << newB.first << " ns\n"
+         << "  format timestamp:     localtime+strftime " << fmtOldNs << " ns, LocalClock " << fmtNs << " ns\n"
+         << "  peak-hour report scan: before " << oldScan.first << " ms, after " << newScan.first << " ms\n"
+         << (ok ? "PASS\n" : "FAIL\n");
+    return ok;
+}
+
+// Admission lookups against a 2M-plate list (written to a scratch file in the
+// current directory and removed afterwards), then lookup latency on one thread
+// while another keeps reloading and swapping the list.
+static bool bench_admission() {
+    const char* path = "bench_plates.tmp";
+    const size_t n = 2000000, probes = 1000000;
+    {
+        ofstream ofs(path, ios::binary);
+        char buf[32];
+        for (size_t i = 0; i < n; ++i) { snprintf(buf, sizeof(buf), "KA%08zu,", i * 2); ofs << buf << (i % 50 == 0 ? "BANNED" : i % 97 == 0 ? "STOLEN" : "PERMIT") << "\n"; }
+    }
+    string err;
+    auto t0 = chrono::steady_clock::now();
+    auto pl = PlateList::open(path, err);
+    double loadMs = elapsed_ns(t0) / 1e6;
+    if (!pl) { cerr << "load failed: " << err << "\n"; remove(path); return false; }
+    atomic_store(&plate_list_ptr, pl);
+    vector<string> unlisted(probes), listed(probes), nearMiss(probes);
+    mt19937_64 rng(3); char buf[32];
+    for (size_t i = 0; i < probes; ++i) {
+        snprintf(buf, sizeof(buf), "MH%08llu", static_cast<unsigned long long>(rng() % 100000000)); unlisted[i] = buf;
+        snprintf(buf, sizeof(buf), "KA%08zu", (rng() % n) * 2); listed[i] = buf;
+        snprintf(buf, sizeof(buf), "KA%08zu", (rng() % n) * 2 + 1); nearMiss[i] = buf; // same prefix, never listed
     }
+    auto timeLookups = [](const vector<string>& plates, size_t& hits) {
+        hits = 0; auto start = chrono::steady_clock::now();
+        for (const auto& p : plates) hits += admission_check(p) != Admission::NotListed;
+        return elapsed_ns(start) / plates.size();
+    };
+    size_t hU, hL, hN;
+    double nsU = timeLookups(unlisted, hU), nsL = timeLookups(listed, hL), nsN = timeLookups(nearMiss, hN);
+    // Reload under traffic.
+    atomic<bool> stop{false}; vector<double> lat; lat.reserve(4000000);
+    thread gate([&] {
+        size_t i = 0;
+        while (!stop.load()) { auto s0 = chrono::steady_clock::now(); admission_check(unlisted[i++ % probes]); lat.push_back(elapsed_ns(s0)); }
+    });
+    int reloads = 0;
+    for (; reloads < 5; ++reloads) { auto fresh = PlateList::open(path, err); if (fresh) atomic_store(&plate_list_ptr, fresh); }
+    stop = true; gate.join();
+    sort(lat.begin(), lat.end());
+    atomic_store(&plate_list_ptr, shared_ptr<const PlateList>(make_shared<PlateList>()));
+    pl.reset();
+    remove(path);
+    bool ok = hU == 0 && hL == probes && hN == 0;
+    cout << "Admission check, " << n << " listed plates\n" << fixed << setprecision(1)
+         << "  load + validate + build filter: " << loadMs << " ms\n"
+         << "  not listed (other prefix):  " << nsU << " ns/lookup\n"
+         << "  not listed (same prefix):   " << nsN << " ns/lookup\n"
+         << "  listed (Bloom + search):    " << nsL << " ns/lookup\n"
+         << "  during " << reloads << " reloads: " << lat.size() << " lookups, p50 " << lat[lat.size() / 2] << " ns, p99 " << lat[lat.size() * 99 / 100] << " ns\n"
+         << (ok ? "PASS\n" : "FAIL\n");
+    return ok;
 }
 
-int main() {
+// Fixed ParkingLot<F, S> against ParkingLot<DYNAMIC, DYNAMIC> with the same
+// geometry at 90% occupancy. Each path is timed as one batch:
+// exit+entry = release a random spot, firstFree, park; lookup = firstFree alone;
+// occupancy = per-floor counters plus a walk of the occupied spots.
+template <class Lot>
+static array<double, 3> bench_lot_paths(Lot& lt, int ops) {
+    vector<unique_ptr<Vehicle>> pool;
+    for (int i = 0; i < lt.capacity(); ++i) pool.push_back(make_unique<Car>("L" + std::to_string(i), "bench", VehicleType::Car));
+    vector<pair<int,int>> parked;
+    for (int i = 0; i < lt.capacity() * 9 / 10; ++i) { auto p = lt.firstFree(); lt.park(p.first, p.second, std::move(pool.back())); pool.pop_back(); parked.push_back(p); }
+    vector<size_t> picks(ops); mt19937 rng(9); for (auto& j : picks) j = rng() % parked.size();
+    long long sink = 0;
+    auto t0 = chrono::steady_clock::now();
+    for (int k = 0; k < ops; ++k) {
+        size_t j = picks[k];
+        auto v = lt.release(parked[j].first, parked[j].second);
+        auto p = lt.firstFree(); lt.park(p.first, p.second, std::move(v));
+        parked[j] = p;
+    }
+    double cycleNs = elapsed_ns(t0) / ops;
+    t0 = chrono::steady_clock::now();
+    for (int k = 0; k < ops; ++k) sink += lt.firstFree().second;
+    double freeNs = elapsed_ns(t0) / ops;
+    t0 = chrono::steady_clock::now();
+    for (int k = 0; k < ops; ++k) {
+        for (int f = 0; f < lt.floors(); ++f) sink += lt.occupiedOnFloor(f);
+        lt.forEachOccupied([&](int, int s, const ParkingSpot&) { sink += s; });
+    }
+    double occNs = elapsed_ns(t0) / ops;
+    volatile long long keep = sink; (void)keep;
+    return {cycleNs, freeNs, occNs};
+}
+
+template <int F, int S>
+static void bench_lot_geometry(int ops) {
+    ParkingLot<F, S> fixedLot;
+    ParkingLot<DYNAMIC, DYNAMIC> dynLot(F, S);
+    auto a = bench_lot_paths(fixedLot, ops), b = bench_lot_paths(dynLot, ops);
+    cout << "  " << F << " x " << S << fixed << setprecision(1) << "\n";
+    const char* names[3] = {"exit+entry", "firstFree", "occupancy"};
+    for (int i = 0; i < 3; ++i)
+        cout << "    " << left << setw(11) << names[i] << right << "fixed " << setw(8) << a[i] << " ns   dynamic " << setw(8) << b[i] << " ns\n";
+}
+
+static void bench_lot() {
+    cout << "ParkingLot fixed vs DYNAMIC geometry (90% full)\n";
+    bench_lot_geometry<FLOORS, SPOTS_PER_FLOOR>(500000);
+    bench_lot_geometry<3, 16>(500000);
+    bench_lot_geometry<20, 50>(200000);
+}
+
+// End-of-day rollup over a synthetic 120-day log in a scratch directory (removed
+// afterwards): pipeline throughput against a plain sequential read of the same
+// file, a check that summaries plus kept rows account for every generated
+// session, and the revenue report before (raw scan) and after (summaries + open day).
+static bool bench_rollup() {
+    const string dir = "bench_rollup.tmp", txn = dir + "/transactions.csv", days = dir + "/days";
+    const size_t n = 3000000; const int span = 120;
+    make_dir(dir);
+    const LocalClock& clock = local_clock();
+    long long now = static_cast<long long>(time(nullptr)), today = clock.dayIndex(now);
+    long long first = static_cast<long long>(clock.dayStart(today - span));
+    DaySummary expectClosed; long long expectOpen = 0, expectCents = 0;
+    {
+        ofstream ofs(txn, ios::binary);
+        ofs << "license,type,entryTime,exitTime,durationMin,fee\n";
+        mt19937_64 rng(35); char buf[96];
+        for (size_t i = 0; i < n; ++i) {
+            long long exitT = first + static_cast<long long>(static_cast<double>(now - first) * i / n);
+            long dur = 1 + static_cast<long>(rng() % 600); long long entry = exitT - dur * 60; int t = static_cast<int>(rng() % VEHICLE_TYPES);
+            Money fee = decltype(lot)::fee(intToType(t), dur);
+            snprintf(buf, sizeof(buf), "KA%06llu,%d,%lld,%lld,%ld,", static_cast<unsigned long long>(rng() % 200000), t, entry, exitT, dur);
+            ofs << buf << fee << "\n";
+            expectCents += fee.cents();
+            if (clock.dayIndex(exitT) < today) { ++expectClosed.sessions; expectClosed.revenueCents[t] += fee.cents(); ++expectClosed.entriesByHour[clock.hour(entry)]; }
+            else ++expectOpen;
+        }
+    }
+    long long bytes = 0; { ifstream f(txn, ios::binary | ios::ate); bytes = static_cast<long long>(f.tellg()); }
+    auto revenue_raw = [](const string& path) {
+        long long cents = 0;
+        scan_csv(path, LLONG_MAX, [&](const vector<string>& cols) { Money fee; if (cols.size() >= 6 && Money::parse(cols[5], fee)) cents += fee.cents(); });
+        return cents;
+    };
+    auto t0 = chrono::steady_clock::now();
+    { ifstream in(txn, ios::binary); vector<char> buf(4 << 20); long long got = 0; while (in.read(buf.data(), buf.size()) || in.gcount() > 0) got += in.gcount(); volatile long long sink = got; (void)sink; }
+    double readMs = elapsed_ns(t0) / 1e6;
+    t0 = chrono::steady_clock::now();
+    long long beforeCents = revenue_raw(txn);
+    double beforeMs = elapsed_ns(t0) / 1e6;
+    RollupStats st; string err;
+    t0 = chrono::steady_clock::now();
+    bool ran = run_rollup(txn, days, today, false, st, err);
+    double rollMs = elapsed_ns(t0) / 1e6;
+    if (!ran) cerr << "rollup failed: " << err << "\n";
+    t0 = chrono::steady_clock::now();
+    RollupIndex idx; long long skipped = 0; load_summaries(days, idx, skipped);
+    DaySummary got = idx.total();
+    long long afterCents = revenue_raw(txn); for (auto c : got.revenueCents) afterCents += c;
+    double afterMs = elapsed_ns(t0) / 1e6;
+    long long partitionRows = 0;
+    for (const auto& kv : idx.days) { scan_csv(partition_path(days, kv.first), LLONG_MAX, [&](const vector<string>&) { ++partitionRows; }); remove(partition_path(days, kv.first).c_str()); }
+    bool ok = ran && got.sessions == expectClosed.sessions && got.revenueCents == expectClosed.revenueCents && got.entriesByHour == expectClosed.entriesByHour
+           && st.kept == expectOpen && st.malformed == 0 && skipped == 0 && partitionRows == st.rolled && beforeCents == expectCents && afterCents == expectCents;
+    remove((days + "/summaries.csv").c_str()); remove(txn.c_str());
+#ifdef _WIN32
+    _rmdir(days.c_str()); _rmdir(dir.c_str());
+#else
+    rmdir(days.c_str()); rmdir(dir.c_str());
+#endif
+    cout << "End-of-day rollup, " << n << " rows over " << span << " days (" << bytes / (1 << 20) << " MB)\n" << fixed << setprecision(1)
+         << "  sequential read:   " << readMs << " ms (" << bytes / 1048576.0 / (readMs / 1e3) << " MB/s)\n"
+         << "  rollup pipeline:   " << rollMs << " ms (" << bytes / 1048576.0 / (rollMs / 1e3) << " MB/s), " << st.rolled << " rows into " << st.days << " partitions, " << st.kept << " kept\n"
+         << "  revenue report:    raw log " << beforeMs << " ms, summaries + open day " << afterMs << " ms\n"
+         << (ok ? "PASS\n" : "FAIL\n");
+    return ok;
+}
+
+// Mergeability: 150k synthetic exits over 70 days, split across three lots.
+// Each lot's sketches go through save_sketches/load_sketches in a scratch file
+// and are merged; the result must equal sketches built from the combined
+// stream exactly (HLL register max, DDSketch bin sums and heatmap sums are all
+// exact), including the 56-day trim.
+static bool bench_sketches() {
+    const size_t n = 150000; const int lots = 3, span = 70;
+    const LocalClock& clock = local_clock();
+    long long now = static_cast<long long>(time(nullptr));
+    AnalyticsSketches combined; vector<AnalyticsSketches> perLot(lots);
+    mt19937_64 rng(30);
+    auto t0 = chrono::steady_clock::now();
+    for (size_t i = 0; i < n; ++i) {
+        long long exitT = now - span * 86400LL + static_cast<long long>(static_cast<double>(span) * 86400 * i / n);
+        long dur = 1 + static_cast<long>(rng() % 900);
+        string plate = "KA" + std::to_string(rng() % 50000);
+        VehicleType t = intToType(static_cast<int>(rng() % VEHICLE_TYPES));
+        sketch_add(combined, plate, t, exitT - dur * 60, exitT, dur);
+        sketch_add(perLot[i % lots], plate, t, exitT - dur * 60, exitT, dur);
+    }
+    double addMs = elapsed_ns(t0) / 1e6;
+    AnalyticsSketches merged; bool io = true;
+    t0 = chrono::steady_clock::now();
+    for (int l = 0; l < lots; ++l) {
+        string path = "bench_sketches_lot" + std::to_string(l) + ".tmp";
+        AnalyticsSketches loaded;
+        io = save_sketches(perLot[l], path) && load_sketches(path, loaded) && io;
+        remove(path.c_str());
+        merged.merge(loaded);
+    }
+    double mergeMs = elapsed_ns(t0) / 1e6;
+    bool same = merged.daily.size() == combined.daily.size() && static_cast<int>(merged.daily.size()) == SKETCH_DAYS;
+    for (auto a = merged.daily.begin(), b = combined.daily.begin(); same && a != merged.daily.end(); ++a, ++b)
+        same = a->first == b->first && a->second->encode() == b->second->encode();
+    for (int t = 0; same && t < VEHICLE_TYPES; ++t) same = merged.durations[t]->encode() == combined.durations[t]->encode();
+    same = same && merged.heat->counts == combined.heat->counts;
+    long long today = clock.dayIndex(now);
+    // Exit path: sketches_record copies only the parts it touches from the published set.
+    atomic_store(&current_sketches_ptr, shared_ptr<const AnalyticsSketches>(make_shared<AnalyticsSketches>(combined)));
+    const int exits = 20000;
+    t0 = chrono::steady_clock::now();
+    for (int i = 0; i < exits; ++i) sketches_record("EX" + std::to_string(i), intToType(i % VEHICLE_TYPES), now - 3600, now, 60);
+    double exitUs = elapsed_ns(t0) / exits / 1000;
+    sketches_dirty = false;
+    bool ok = io && same;
+    cout << "Sketch merge, " << n << " exits over " << span << " days across " << lots << " lots\n" << fixed << setprecision(1)
+         << "  build (in place): " << addMs * 1e3 / (2 * n) << " us/row, save+load+merge: " << mergeMs << " ms\n"
+         << "  exit update (copy-on-write): " << setprecision(2) << exitUs << setprecision(1) << " us\n"
+         << "  unique 28 days: merged " << llround(merged.uniqueOver(today, 28)) << ", combined " << llround(combined.uniqueOver(today, 28)) << "\n"
+         << "  car p90: merged " << merged.durations[1]->quantile(0.9) << ", combined " << combined.durations[1]->quantile(0.9) << " min\n"
+         << "  merged == combined stream: " << (same ? "yes" : "NO") << "\n"
+         << (ok ? "PASS\n" : "FAIL\n");
+    return ok;
+}
+
+static int run_bench(const string& name) {
+    if (name == "alloc") bench_alloc();
+    else if (name == "snapshot") { if (!bench_snapshot()) return 1; }
+    else if (name == "money") { if (!bench_money()) return 1; }
+    else if (name == "timescan") { if (!bench_timescan()) return 1; }
+    else if (name == "admission") { if (!bench_admission()) return 1; }
+    else if (name == "lot") bench_lot();
+    else if (name == "rollup") { if (!bench_rollup()) return 1; }
+    else if (name == "sketches") { if (!bench_sketches()) return 1; }
+    else { cerr << "Unknown benchmark: " << name << " (available: alloc, snapshot, money, timescan, admission, lot, rollup, sketches)\n"; return 1; }
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    if (argc >= 3 && string(argv[1]) == "--bench") return run_bench(argv[2]);
+    if (argc >= 3 && string(argv[1]) == "--merge-sketches") return merge_sketches_report(vector<string>(argv + 2, argv + argc));
+    if (argc >= 2 && string(argv[1]) == "--rollup") { // one-off job; run it while no interactive session is open
+        ensure_dir(); init_rollup();
+        RollupStats st; string err;
+        if (!rollup_now(st, err)) { cerr << "Error: " << err << "\n"; return 1; }
+        cout << rollup_summary(st);
+        return 0;
+    }
+    bool autoRollup = argc >= 2 && string(argv[1]) == "--auto-rollup";
     ios::sync_with_stdio(false); cin.tie(nullptr);
     ensure_dir();
+    init_rollup();
     load_state();
+    occupancy_recount();
+    geometry = load_geometry();
+    use_strategy(make_strategy(0));
+    load_allocation();
+    { ifstream txf(TRANSACTIONS_CPP, ios::binary | ios::ate); if (txf) txn_bytes = static_cast<long long>(txf.tellg()); }
+    publish_all();
+    init_sketches();
+    { pair<long long, long long> sig; string err; if (file_signature(PLATES_CPP, sig) && !plates_load_now(err)) cerr << "Warning: plate list not loaded: " << err << "\n"; }
+    occ_history.record(time(nullptr), occ_counts);
+    deadline_wheel.start(static_cast<long long>(time(nullptr)) / 60);
+    lot.forEachOccupied([](int f, int s, const ParkingSpot& ps) {
+        deadline_register(*ps.vehicle, f, s);
+    });
+    on_overstay([](const DeadlineEvent& ev) {
+        cout << "\n[ALERT] " << ev.license << " at Floor " << (ev.floor+1) << ", Spot " << (ev.spot+1) << (ev.prepaid ? " is past its prepaid window\n" : " exceeded the maximum stay\n");
+    });
+    if (autoRollup) start_auto_rollup();
     while (true) {
+        deadline_tick(time(nullptr));
+        admission_poll();
+        sketches_poll();
+        rollup_poll();
         cout << "\n==============================\n Smart Parking System (C++)\n Floors: " << FLOORS << ", Spots/Floor: " << SPOTS_PER_FLOOR << "\n==============================\n";
-        cout << "1. Vehicle Entry (Park)\n2. Vehicle Exit\n3. Search Vehicle\n4. Reports\n5. Save & Exit\n> ";
+        cout << "1. Vehicle Entry (Park)\n2. Vehicle Exit\n3. Search Vehicle\n4. Reports\n5. Save & Exit\n6. Allocation Settings\n7. End-of-Day Rollup\n> ";
         string line; getline(cin, line); trim(line); if (line.empty()) continue; int choice = 0; try { choice = stoi(line); } catch (...) { cout << "Invalid input\n"; continue; }
         try {
             if (choice==1) menu_entry();
@@ -354,10 +2712,15 @@ int main() {
             else if (choice==3) menu_search();
             else if (choice==4) reports_menu();
             else if (choice==5) { if (!save_state()) cerr << "Warning: failed to save state\n"; cout << "Goodbye!\n"; break; }
+            else if (choice==6) menu_allocation();
+            else if (choice==7) { RollupStats st; string err; if (!rollup_now(st, err)) throw runtime_error(err); cout << rollup_summary(st); }
             else cout << "Invalid choice\n";
         } catch (const exception& e) {
             cout << "Error: " << e.what() << "\n";
         }
     }
+    if (plate_reload_thread.joinable()) plate_reload_thread.join();
+    stop_auto_rollup();
+    sketches_flush();
     return 0;
 }